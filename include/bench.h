@@ -0,0 +1,19 @@
+#ifndef BENCH_H_INCLUDED_
+#define BENCH_H_INCLUDED_
+
+// Benchmark tasks. Each one times its loops with clock() (Timer4), prints the
+// results to COM2 with bwprintf and exits. Create them at a higher priority
+// than anything else that is ready so the numbers are not stretched by other
+// tasks, user_main does this when built with -DBENCH.
+
+// CPU cycles per byte of memcpy, memset, memcmp and strncmp for each size class
+void bench_string_main(void);
+
+// CPU cycles per scheduler_put and scheduler_get pair, against the single 64
+// bit bitmap scheduler the two level bitmap replaced
+void bench_scheduler_main(void);
+
+// CPU cycles per null syscall (MyTid), trap to kernel and back
+void bench_syscall_main(void);
+
+#endif // BENCH_H_INCLUDED_
@@ -39,13 +39,8 @@ int DelayUntil(int tid, int ticks);
 // any time.
 void clock_server_main(void);
 
-// Shuts down clock server, will also shut down respective notifier
+// Shuts down clock server
 void clock_server_exit(uint8_t clock_server_tid);
 
-/* Clock Server notifier functions */
-
-// entry point for a clock notifier task
-void clock_server_notifier_main(void);
-
 #endif // CLOCK_SERVER_H_INCLUDED_
 
@@ -8,15 +8,62 @@
 #include <internal/task_descriptor.h>
 
 #define EVENT_HANDLER_MAX_EVENTS 16
+#define EVENT_HANDLER_QUEUE_SIZE 16     // power of two
 
 typedef struct {
-    queue_t await_qs[EVENT_HANDLER_MAX_EVENTS];
+    task_descriptor_t *bound;           // receives the event as a message
+    task_descriptor_t *waiter;          // longest waiting task, NULL if none
+    queue_t await_q;                    // tasks waiting behind it
+    uint32_t pending;                   // events raised while nobody waited
+    uint32_t read_index;
+    int data[EVENT_HANDLER_QUEUE_SIZE]; // their values, oldest at read_index
+} event_handler_event_t;
+
+typedef struct {
+    event_handler_event_t events[EVENT_HANDLER_MAX_EVENTS];
+    queue_t any_q;                      // tasks in AwaitAny, served after waiter
+    uint32_t blocked_count;             // tasks waiting on any event
+    uint32_t bound_count;               // events bound to a task
     scheduler_t *sch;
+    uint32_t irq_time;      // Timer4 time of the interrupt being handled
 } event_handler_t;
 
 void event_handler_init(event_handler_t *ctx, scheduler_t *sch);
 int event_handler_add_task(event_handler_t *ctx, event_t event, task_descriptor_t *td);
+// Wait td on every event in mask (bit n for event n) until one is raised,
+// returns -1 if the mask names no valid event
+int event_handler_add_any(event_handler_t *ctx, uint32_t mask, task_descriptor_t *td);
+// Stop td waiting on any event, returns -1 if it was not waiting
+int event_handler_remove_task(event_handler_t *ctx, task_descriptor_t *td);
+// Deliver event to td through Receive, returns -1 if the event is invalid and
+// -2 if another task has it bound
+int event_handler_bind(event_handler_t *ctx, event_t event, task_descriptor_t *td);
+// Drop all of td's bindings
+void event_handler_unbind_task(event_handler_t *ctx, task_descriptor_t *td);
+// Returns true if event is bound to a task
+bool event_handler_bound(event_handler_t *ctx, event_t event);
+// Stores the message for a bound event in a Receive buffer the way a sender's
+// would be, returns the message size
+int event_handler_store_msg(event_t event, int data, void *msg, size_t msg_len, void **loan);
+// Wake the longest waiting task on event with return value ret. A bound event
+// goes to its task instead, if that task is in Receive. Otherwise ret is
+// queued for the next AwaitEvent or Receive, returns -2 if the queue is full
+// and ret was dropped. Woken tasks are tagged with the event and
+// ctx->irq_time for latency accounting.
 int event_handler_handle_event(event_handler_t *ctx, event_t event, int ret);
+// Wake only the longest waiting task on event, returns -1 if there is none
+int event_handler_wake_first(event_handler_t *ctx, event_t event, int ret);
+// Returns the longest waiting task on event without waking it, or NULL.
+// Tasks in AwaitAny are not returned.
+task_descriptor_t *event_handler_peek(event_handler_t *ctx, event_t event);
+// Returns true if raising event would wake a task or message a bound one
+bool event_handler_waiting(event_handler_t *ctx, event_t event);
+// Returns true if raising event now would drop it, nothing would take it and
+// its queue is full
+bool event_handler_full(event_handler_t *ctx, event_t event);
+// Takes the oldest value queued for event into ret, returns false if none
+bool event_handler_take(event_handler_t *ctx, event_t event, int *ret);
+// Returns true if no task is waiting on or has bound an event
 bool event_handler_empty(event_handler_t *ctx);
 
 #endif // EVENT_HANDLER_H_INCLUDED_
@@ -0,0 +1,72 @@
+#ifndef KERNEL_STATS_H_INCLUDED_
+#define KERNEL_STATS_H_INCLUDED_
+
+#include <int_types.h>
+
+#include <internal/event_handler.h>
+#include <internal/sys_codes.h>
+
+#define KERNEL_STATS_BUCKETS        32                  // log2 buckets of Timer4 cycles
+#define KERNEL_STATS_IRQ            SYS_CODE_COUNT      // slot used for interrupts
+#define KERNEL_STATS_ENTRY_TYPES    (SYS_CODE_COUNT + 1)
+
+typedef struct {
+    uint32_t count;
+    uint32_t total;
+    uint32_t min;
+    uint32_t max;
+    uint32_t histogram[KERNEL_STATS_BUCKETS];
+} kernel_stats_entry_t;
+
+typedef struct {
+    kernel_stats_entry_t entries[KERNEL_STATS_ENTRY_TYPES];
+    kernel_stats_entry_t irq_latency[EVENT_HANDLER_MAX_EVENTS];
+    uint32_t dropped[EVENT_HANDLER_MAX_EVENTS];     // raised with the queue full
+} kernel_stats_t;
+
+// Build with -DKERNEL_STATS_DISABLE (e.g. CFLAGS += -DKERNEL_STATS_DISABLE in
+// config.mk) to compile the recording out of the kernel entry path.
+#ifndef KERNEL_STATS_DISABLE
+
+// Zero all counters
+void kernel_stats_init(kernel_stats_t *ctx);
+
+// Returns the index of the log2 bucket for a value, 0 and 1 share bucket 0
+uint8_t kernel_stats_log2(uint32_t value);
+
+// Record one kernel entry of the given type (a sys_code_t or
+// KERNEL_STATS_IRQ) that took cycles Timer4 cycles from trap to the next
+// activate
+void kernel_stats_record(kernel_stats_t *ctx, uint32_t type, uint32_t cycles);
+
+// Record the Timer4 cycles from the interrupt that raised event until the
+// task it woke was activated
+void kernel_stats_record_irq_latency(kernel_stats_t *ctx, event_t event, uint32_t cycles);
+
+// Count an event that was raised with nobody to take it and its queue full
+void kernel_stats_record_drop(kernel_stats_t *ctx, event_t event);
+
+// Print counts and histograms of every entry type and event seen over COM2
+// using busy wait io
+void kernel_stats_dump(kernel_stats_t *ctx);
+
+#else
+
+static inline void kernel_stats_init(kernel_stats_t *ctx) {
+}
+
+static inline void kernel_stats_record(kernel_stats_t *ctx, uint32_t type, uint32_t cycles) {
+}
+
+static inline void kernel_stats_record_irq_latency(kernel_stats_t *ctx, event_t event, uint32_t cycles) {
+}
+
+static inline void kernel_stats_record_drop(kernel_stats_t *ctx, event_t event) {
+}
+
+static inline void kernel_stats_dump(kernel_stats_t *ctx) {
+}
+
+#endif // KERNEL_STATS_DISABLE
+
+#endif // KERNEL_STATS_H_INCLUDED_
@@ -9,10 +9,13 @@
 #define MEM_KERNEL_STACK_START              ((uintptr_t)&_stack_start)
 #define MEM_KERNEL_STACK_SIZE               (0x2000)            // 8KB stack
 
-#define MEM_TASK_STACK_SIZE                 (0x2000)            // 8KB stack
+#define MEM_TASK_STACK_SIZE                 (0x2000)            // 8KB default stack
+#define MEM_TASK_STACK_MIN_SIZE             (0x100)             // allocation granularity
 
-#define MEM_TASK_STACK_START(task_num)      ((MEM_KERNEL_STACK_START - MEM_KERNEL_STACK_SIZE) \
-                                            - (MEM_TASK_STACK_SIZE * (task_num)))
+// Task stacks are carved out of the region just below the kernel stack
+#define MEM_TASK_STACK_REGION_END           (MEM_KERNEL_STACK_START - MEM_KERNEL_STACK_SIZE)
+#define MEM_TASK_STACK_REGION_SIZE          (0x80000)           // 512KB
+#define MEM_TASK_STACK_REGION_START         (MEM_TASK_STACK_REGION_END - MEM_TASK_STACK_REGION_SIZE)
 extern int _stack_start;
 
 extern int _irq_stack_start;
@@ -0,0 +1,42 @@
+#ifndef MMU_H_INCLUDED_
+#define MMU_H_INCLUDED_
+
+#include <int_types.h>
+
+// Build with -DMMU_DISABLE (e.g. CFLAGS += -DMMU_DISABLE in config.mk) to
+// leave the MMU and caches off as RedBoot hands them over.
+
+#define MMU_SECTIONS            4096            // 1MB sections covering 4GB
+#define MMU_SECTION_SHIFT       20
+#define MMU_TABLE_ALIGN         0x4000          // translation table must be 16KB aligned
+
+#define MMU_RAM_START           0x00000000      // TS-7200 SDRAM as RedBoot maps it
+#define MMU_RAM_SIZE            0x02000000      // 32MB
+
+// First level descriptor bits
+#define MMU_DESCRIPTOR_TYPE     0x3
+#define MMU_SECTION_TYPE        0x2
+#define MMU_SECTION_BUFFERABLE  (1 << 2)
+#define MMU_SECTION_CACHEABLE   (1 << 3)
+
+// CP15 control register bits
+#define MMU_CTRL_MMU            (1 << 0)
+#define MMU_CTRL_DCACHE         (1 << 2)
+#define MMU_CTRL_ICACHE         (1 << 12)
+
+// ARM920T D-cache geometry, used to clean it by index
+#define MMU_DCACHE_SEGMENTS     8
+#define MMU_DCACHE_WAYS         64
+
+// Copy RedBoot's translation table, which maps the TS-7200's 8MB SDRAM banks
+// into the bottom 32MB, keeping every physical address and access setting.
+// RAM sections are made cacheable and write-back and everything else,
+// including the UART, timer and VIC registers, uncached and unbuffered. Then
+// turn on the MMU and both caches.
+void mmu_init(void);
+
+// Write back and invalidate the caches and put back RedBoot's MMU setup with
+// the caches off, must be called before handing control back to RedBoot
+void mmu_cleanup(void);
+
+#endif // MMU_H_INCLUDED_
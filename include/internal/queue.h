@@ -47,6 +47,14 @@ size_t queue_size(queue_t *ctx);
 // Returns true if the queue is empty, false otherwise.
 bool queue_empty(queue_t *ctx);
 
+// Unlinks node from anywhere in the queue. Returns 0 if the node was removed
+// and 1 if it was not in the queue. Takes time linear in the queue length.
+uint8_t queue_remove(queue_t *ctx, queue_node_t *node);
+
+// Inserts node right after parent, or at the front if parent is NULL. Parent
+// must be a node in ctx. Returns 0 on success, 1 otherwise
+uint8_t queue_insert_after(queue_t *ctx, queue_node_t *parent, queue_node_t *node);
+
 // moves the next node of parent to the front of queue ctx, returns 0 on
 // success and 1 if an error occured. Does nothing if parent is NULL. Returns 1
 // if parent does not have a next node. Non-NULL Parent must be a node in ctx
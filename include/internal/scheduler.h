@@ -7,14 +7,20 @@
 #include <internal/task_descriptor.h>
 #include <internal/queue.h>
 
-#define SCHEDULER_PRIORITY_COUNT 64
+#define SCHEDULER_PRIORITY_COUNT 64     // up to 32 * 32
+#define SCHEDULER_GROUP_SIZE 32
+#define SCHEDULER_GROUP_COUNT ((SCHEDULER_PRIORITY_COUNT + SCHEDULER_GROUP_SIZE - 1) / SCHEDULER_GROUP_SIZE)
 
+// Ready queues are found through a two level bitmap. Bit p of groups[g] is
+// set if priority g * 32 + p has ready tasks and bit g of summary is set if
+// groups[g] is non-zero. Lower numbers are higher priorities.
 typedef struct {
-    uint64_t bitmap;
+    uint32_t summary;
+    uint32_t groups[SCHEDULER_GROUP_COUNT];
     queue_t priority_qs[SCHEDULER_PRIORITY_COUNT];
 } scheduler_t;
 
-// initialize struct with empty queues and zero'd bitmap
+// initialize struct with empty queues and zero'd bitmaps
 void scheduler_init(scheduler_t *sch);
 
 // Returns pointer to next TD to be run from the priority queues
@@ -22,10 +28,25 @@ void scheduler_init(scheduler_t *sch);
 // all ready queues are empty
 task_descriptor_t *scheduler_get(scheduler_t *sch);
 
-// add a task to its corresponding ready queue, returns non-zero if
-// TD could not be inserted into the queue
+// add a task to the back of its corresponding ready queue with a fresh time
+// slice, returns non-zero if TD could not be inserted into the queue
 uint8_t scheduler_put(scheduler_t *sch, task_descriptor_t *td);
 
+// add a task to the front of its ready queue keeping the rest of its time
+// slice, used when a task is interrupted before its slice is up. Returns
+// non-zero if TD could not be inserted into the queue
+uint8_t scheduler_put_front(scheduler_t *sch, task_descriptor_t *td);
+
+// remove a ready task from its ready queue, returns non-zero if the TD
+// was not in the queue
+uint8_t scheduler_remove(scheduler_t *sch, task_descriptor_t *td);
+
+// return true if a task of the given priority is ready
+bool scheduler_has_ready(scheduler_t *sch, uint8_t priority);
+
+// drop every ready task, scheduler_get returns NULL until tasks are put again
+void scheduler_clear(scheduler_t *sch);
+
 // return true if empty, false otherwise
 bool scheduler_empty(scheduler_t *sch);
 
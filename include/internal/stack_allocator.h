@@ -0,0 +1,32 @@
+#ifndef STACK_ALLOCATOR_H_INCLUDED_
+#define STACK_ALLOCATOR_H_INCLUDED_
+
+#include <int_types.h>
+
+#include <internal/mem.h>
+
+#define STACK_ALLOCATOR_CHUNK_SIZE  MEM_TASK_STACK_MIN_SIZE
+#define STACK_ALLOCATOR_CHUNKS      (MEM_TASK_STACK_REGION_SIZE / STACK_ALLOCATOR_CHUNK_SIZE)
+#define STACK_ALLOCATOR_WORDS       (STACK_ALLOCATOR_CHUNKS / 32)
+
+// First fit allocator over fixed size chunks of the task stack region, a set
+// bit in the bitmap marks a chunk in use
+typedef struct {
+    uintptr_t base;
+    uint32_t bitmap[STACK_ALLOCATOR_WORDS];
+} stack_allocator_t;
+
+// Mark the whole region starting at base as free
+void stack_allocator_init(stack_allocator_t *ctx, uintptr_t base);
+
+// Rounds size up to a whole number of chunks
+size_t stack_allocator_round(size_t size);
+
+// Returns the lowest address of a free block of at least size bytes, or NULL
+// if size is zero or no free block is large enough
+void *stack_allocator_alloc(stack_allocator_t *ctx, size_t size);
+
+// Return a block from stack_allocator_alloc of the same size to the region
+void stack_allocator_free(stack_allocator_t *ctx, void *stack, size_t size);
+
+#endif // STACK_ALLOCATOR_H_INCLUDED_
@@ -1,7 +1,8 @@
 #ifndef SYS_CODES_H_INCLUDED_
 #define SYS_CODES_H_INCLUDED_
 
-#define SWI(code) __asm__ volatile ("swi %0" : : "I" (code))
+// The sys code is passed to the kernel in ip, the swi immediate is not read
+#define SWI(code) __asm__ volatile ("mov ip, %0\n\tswi %0" : : "I" (code) : "ip")
 
 typedef enum {
     SYS_CODE_EXIT,
@@ -14,9 +15,36 @@ typedef enum {
     SYS_CODE_REPLY,
     SYS_CODE_AWAITEVENT,
     SYS_CODE_PANIC,
-    SYS_CODE_QUIT
+    SYS_CODE_QUIT,
+    SYS_CODE_REPLYRECEIVE,
+    SYS_CODE_SENDLOAN,
+    SYS_CODE_RECEIVELOAN,
+    SYS_CODE_SENDSHORT,
+    SYS_CODE_TASKSTATS,
+    SYS_CODE_DESTROY,
+    SYS_CODE_CREATEEX,
+    SYS_CODE_SETQUANTUM,
+    SYS_CODE_SETTIMER,
+    SYS_CODE_AWAITEVENTBUF,
+    SYS_CODE_AWAITANY,
+    SYS_CODE_BINDEVENT,
+    SYS_CODE_SLEEP,
+    SYS_CODE_SLEEPUNTIL,
+    SYS_CODE_RECEIVETIMEOUT,
+    SYS_CODE_AWAITEVENTTIMEOUT,
+    SYS_CODE_RECEIVESHORT,
+    SYS_CODE_COUNT      // number of sys codes, keep last
 } sys_code_t;
 
+// Short messages are passed in r1-r3. For SendShort r0 holds the control word,
+// for ReceiveShort r0 holds the tid pointer and r1 the buffer size on entry.
+#define SHORT_MSG_REG_OFFSET                1
+#define SHORT_MSG_CTRL(tid, msg_len, rep_len) \
+    ((uint32_t)(tid) | ((uint32_t)(msg_len) << 8) | ((uint32_t)(rep_len) << 16))
+#define SHORT_MSG_CTRL_TID(ctrl)            ((ctrl) & 0xFF)
+#define SHORT_MSG_CTRL_MSG_LEN(ctrl)        (((ctrl) >> 8) & 0xFF)
+#define SHORT_MSG_CTRL_REP_LEN(ctrl)        (((ctrl) >> 16) & 0xFF)
+
 typedef struct {
     uint8_t tid;
     void *msg;
@@ -25,4 +53,14 @@ typedef struct {
     size_t rep_len;
 } send_params_t;
 
+typedef struct {
+    uint8_t reply_tid;
+    void *rep;
+    size_t rep_len;
+    uint8_t *tid;
+    void *msg;
+    size_t msg_len;
+    void **loan;
+} reply_receive_params_t;
+
 #endif // SYS_CODES_H_INCLUDED_
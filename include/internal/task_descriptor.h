@@ -2,9 +2,22 @@
 #define TASK_DESCRIPTOR_H_INCLUDED_
 
 #include <internal/queue.h>
+#include <bool.h>
 #include <int_types.h>
+#include <sys_call.h>
+#include <time.h>
 
 #define TASK_DESCRIPTOR_MAX_TASKS 64
+#define TASK_DESCRIPTOR_DEFAULT_QUANTUM 1   // ticks
+#define TASK_DESCRIPTOR_TICK_CLOCKS (CLOCKS_PER_SEC / CLOCK_TICKS_PER_SEC)
+
+// A tid is the descriptor index in the low bits and a generation count in the
+// bits above it. The generation is bumped each time a descriptor is recycled
+// so a stale tid no longer matches the descriptor's new owner. With 8 bit tids
+// only 2 generation bits are left, so a stale tid can alias again after the
+// slot has been reused 4 times.
+#define TASK_DESCRIPTOR_INDEX(tid)      ((tid) & (TASK_DESCRIPTOR_MAX_TASKS - 1))
+#define TASK_DESCRIPTOR_NEXT_TID(tid)   ((uint8_t)((tid) + TASK_DESCRIPTOR_MAX_TASKS))
 
 enum task_state_t {
     READY,
@@ -13,38 +26,85 @@ enum task_state_t {
     SEND_BLOCKED,
     RECEIVE_BLOCKED,
     REPLY_BLOCKED,
-    EVENT_BLOCKED
+    EVENT_BLOCKED,
+    SLEEPING,
+    FREE
 };
 
 typedef struct task_descriptor {
     uint8_t tid;
-    uint8_t priority;
-    struct task_descriptor *parent;
+    uint8_t priority;       // effective, may be raised by priority inheritance
+    uint8_t base_priority;  // as created
+    uint8_t quantum;        // time slice in 10ms ticks
+    int parent_tid;         // -1 if the task has no parent
     queue_node_t ready_node;
     queue_node_t send_node;
     queue_node_t await_node;
     queue_t send_q;
+    queue_t reply_q;        // tasks waiting on this task's reply, by send_node
     enum task_state_t state;
-    void *sp;
-    void *svc_lr;
+    struct task_descriptor *blocked_on;     // receiver of the last Send
+    void *sp;               // sp, svc_lr and spsr are saved and restored together
+    void *svc_lr;           // by task_switch, keep them in this order
     uint32_t spsr;
+    uint8_t *stack;         // lowest address of the stack
+    size_t stack_size;
 
     struct {
         uint8_t *tid;
         void *msg;
         size_t msg_len;
+        bool loan;          // sender lent msg instead of having it copied
+        void **loan_dest;   // receiver accepts loans, where to store the pointer
         void *rep;
         size_t rep_len;
     } message_params;
+
+    struct {
+        uint8_t *buf;       // NULL unless waiting in AwaitEventBuf
+        size_t len;
+        size_t count;       // bytes received so far
+        uint32_t any_mask;  // 0 unless waiting in AwaitAny
+        int *which;
+        int *data;
+    } event_params;
+    uint32_t bound_events;  // events delivered to this task through Receive
+
+    task_stats_t stats;
+    uint32_t state_time;    // Timer4 time the task started running or blocked
+    int wake_event;         // event that woke the task, -1 once accounted for
+    uint32_t wake_time;     // Timer4 time of the interrupt that woke the task
+    uint32_t slice_left;    // Timer4 cycles left in the current time slice
+    bool timeout_set;       // on the kernel's sleep queue
+    clock_t timeout;        // Timer4 time to wake the task if still blocked
+    queue_node_t timer_node;
 } task_descriptor_t;
 
+#define TASK_DESCRIPTOR_STACK_PAINT 0xA5      // fill byte for unused stack
+
 // Initialize a task descriptor with the given parameters.
 // queue node have data pointer set to the ctx task descriptor
+// The stack is painted so its high-water mark can be measured later.
 // should spsr be initialized here too?
 void task_descriptor_init(
     task_descriptor_t *ctx, uint8_t tid, uint8_t priority,
-    task_descriptor_t *parent, void (*code) (void));
+    int parent_tid, void (*code) (void), void *stack, size_t stack_size);
+
+// Returns the most stack the task has used, in bytes. Found by scanning for
+// the deepest word that no longer holds the paint.
+size_t task_descriptor_stack_used(task_descriptor_t *ctx);
 
 void task_descriptor_set_return_value(task_descriptor_t *ctx, int ret);
 
+// Account for the task starting to run at time now
+void task_descriptor_start_running(task_descriptor_t *ctx, uint32_t now);
+
+// Account for the task leaving the CPU at time now. Any time until it is
+// made ready again is counted against the state it is left in. The time run
+// is taken off the task's time slice.
+void task_descriptor_stop_running(task_descriptor_t *ctx, uint32_t now, bool preempted);
+
+// Account for the time the task spent blocked, call before it is made ready
+void task_descriptor_end_blocked(task_descriptor_t *ctx, uint32_t now);
+
 #endif // TASK_DESCRIPTOR_H_INCLUDED_
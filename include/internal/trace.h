@@ -0,0 +1,58 @@
+#ifndef TRACE_H_INCLUDED_
+#define TRACE_H_INCLUDED_
+
+#include <int_types.h>
+
+#define TRACE_BUFFER_EVENTS     1024        // oldest events are overwritten
+#define TRACE_DUMP_MAGIC        "KTRC"
+
+// Event types, shared with tools/trace2json.c
+typedef enum {
+    TRACE_SYSCALL_ENTRY,    // code: sys code, arg0/arg1: first two arguments
+    TRACE_SYSCALL_EXIT,     // code: sys code, arg0: return value, arg1: 1 if the
+                            // caller blocked or exited and has no return value
+    TRACE_IRQ,              // code: vectored event, arg0: serviced event
+    TRACE_SWITCH,           // tid: task being activated, code: its priority
+    TRACE_WAKEUP            // tid: task woken, code: event, arg0: event data
+} trace_type_t;
+
+// 16 byte binary record, dumped as is (little endian)
+typedef struct {
+    uint32_t time_low;      // Timer4 value, low 32 bits
+    uint8_t time_high;      // Timer4 value, high 8 bits
+    uint8_t type;
+    uint8_t tid;
+    uint8_t code;
+    uint32_t arg0;
+    uint32_t arg1;
+} trace_event_t;
+
+// Build with -DTRACE_DISABLE (e.g. CFLAGS += -DTRACE_DISABLE in config.mk) to
+// compile the trace hooks out of the kernel.
+#ifndef TRACE_DISABLE
+
+// Empty the trace buffer
+void trace_init(void);
+
+// Append an event stamped with the current Timer4 value
+void trace_record(trace_type_t type, uint8_t tid, uint8_t code, uint32_t arg0, uint32_t arg1);
+
+// Write the buffered events, oldest first, over COM2 in binary using busy
+// wait io. The dump is TRACE_DUMP_MAGIC, the event count and clocks per
+// second as 32 bit words, then the events.
+void trace_dump(void);
+
+#else
+
+static inline void trace_init(void) {
+}
+
+static inline void trace_record(trace_type_t type, uint8_t tid, uint8_t code, uint32_t arg0, uint32_t arg1) {
+}
+
+static inline void trace_dump(void) {
+}
+
+#endif // TRACE_DISABLE
+
+#endif // TRACE_H_INCLUDED_
@@ -19,10 +19,14 @@ typedef enum {
 
 typedef struct {
     io_server_msg_type_t type;
-    unsigned char data[IO_SERVER_MSG_MAX_DATA_LEN];
     size_t len;
+    unsigned char data[IO_SERVER_MSG_MAX_DATA_LEN];
 } io_server_msg_t;
 
+// Size of a message carrying data_len bytes of data, only this much is sent
+#define IO_SERVER_MSG_SIZE(data_len) \
+    (sizeof(io_server_msg_t) - IO_SERVER_MSG_MAX_DATA_LEN + (data_len))
+
 /* Wrapper Functions */
 
 // Shuts down io server, will also shut down respective notifiers
@@ -3,26 +3,90 @@
 
 #include <int_types.h>
 
+#define SYS_CALL_SHORT_MSG_MAX_LEN 12
+
+// Returned by the timeout variants of blocking calls when the time runs out
+#define SYS_CALL_TIMEOUT -5
+
 typedef enum {
     SYS_CALL_EVENT_TIMER,
     SYS_CALL_EVENT_UART1,
     SYS_CALL_EVENT_UART1_MS,
     SYS_CALL_EVENT_UART1_RX,
-    SYS_CALL_EVENT_UART1_RT,
+    SYS_CALL_EVENT_UART1_RT,    // unused, receive timeouts raise the RX event
     SYS_CALL_EVENT_UART1_TX,
     SYS_CALL_EVENT_UART2,
     SYS_CALL_EVENT_UART2_RX,
-    SYS_CALL_EVENT_UART2_RT,
+    SYS_CALL_EVENT_UART2_RT,    // unused, receive timeouts raise the RX event
     SYS_CALL_EVENT_UART2_TX,
 } event_t;
 
+// Message a task receives for an event bound to it with BindEvent
+typedef struct {
+    int event;
+    int data;               // what AwaitEvent would have returned
+} event_msg_t;
+
+// Per-task accounting, times are in Timer4 cycles (CLOCKS_PER_SEC)
+typedef struct {
+    uint32_t run_time;              // running
+    uint32_t send_blocked_time;     // in Receive, waiting for a sender
+    uint32_t receive_blocked_time;  // in Send, waiting for the receiver
+    uint32_t reply_blocked_time;    // in Send, waiting for the reply
+    uint32_t event_blocked_time;    // in AwaitEvent
+    uint32_t sleep_time;            // in Sleep or SleepUntil
+    uint32_t scheduled_count;       // times the task was activated
+    uint32_t preempted_count;       // times the task was interrupted
+    uint32_t stack_size;            // bytes
+    uint32_t stack_used;            // high-water mark in bytes
+} task_stats_t;
+
 // Task Management
 int Create(int priority, void (*code) ());
+
+// Create a task with a stack of at least stack_size bytes, Create uses 8KB.
+// Stacks are allocated in 256 byte units. Returns the tid of the new task,
+// -1 if the priority is invalid, -2 if no task descriptors are left and -3
+// if a stack of that size cannot be allocated.
+int CreateEx(int priority, void (*code) (), size_t stack_size);
 int MyTid();
 int MyParentTid();
 void Pass();
+
+// Block for ticks ticks, timed by the kernel without the clock server.
+// Returns 0, right away if ticks is 0 or less.
+int Sleep(int ticks);
+
+// Block until clock_to_ticks(clock()) reaches ticks, the timebase SetTimer
+// uses. Returns 0, right away if that time has passed.
+int SleepUntil(int ticks);
+
+// Arm the timer event. The next AwaitEvent(SYS_CALL_EVENT_TIMER) returns once
+// clock_to_ticks(clock()) reaches ticks, with the tick count as its value.
+// Replaces any earlier deadline, a negative ticks cancels it. There is no
+// periodic tick. Returns 0.
+int SetTimer(int ticks);
+
+// Set the caller's time slice to ticks 10ms ticks, from 1 to 255, starting
+// with its next slice. A task that runs for its whole slice is
+// moved behind the other ready tasks of its priority, one that is interrupted
+// earlier keeps running. Tasks start with a 1 tick slice. Returns the old
+// quantum, or -1 if ticks is out of range.
+int SetQuantum(int ticks);
 void Exit();
 
+// Exit and Destroy free the task's descriptor and stack for reuse by Create.
+// Tasks blocked sending to the destroyed task, or waiting on its reply, fail
+// their Send with -1. Its tid is retired and no longer names a task.
+// Returns 0 on success, -1 if tid does not name a task, -2 if tid is the
+// caller, which should Exit instead, and -3 if the task is waiting on the
+// reply to a SendLoan, whose receiver may still be using the lent buffer.
+int Destroy(uint8_t tid);
+
+// Copy the accounting of the given task into stats.
+// Returns 0 on success, -1 if tid does not name a task.
+int TaskStats(uint8_t tid, task_stats_t *stats);
+
 // Message Passing
 
 // Send a message to a specified task and block until a reply is received.
@@ -30,30 +94,124 @@ void Exit();
 // msg: A pointer to the message to send
 // msg_len: The size of the message, in bytes
 // rep: A pointer to a buffer to store the reply
-// rep_len: The expected reply size, in bytes
+// rep_len: The size of the reply buffer, in bytes
 //
-// Returns 0 if no error occurred and a negative value otherwise.
+// Only the first rep_len bytes of a longer reply are stored.
+// Returns the size of the reply sent by the receiver, which is larger than
+// rep_len if the reply was truncated, or a negative value if an error occurred.
 int Send(uint8_t tid, void *msg, size_t msg_len, void *rep, size_t rep_len);
 
+// Send a short message, carried to the receiver in registers rather than
+// through a parameter block. Arguments are the same as Send, but msg_len and
+// rep_len can be at most SYS_CALL_SHORT_MSG_MAX_LEN bytes. msg and rep must be
+// word aligned, and are read and written a whole word at a time, so rep needs
+// room for rep_len rounded up to a word. The receiver can use Receive, or
+// ReceiveShort to take the message in registers as well.
+//
+// Returns the size of the reply like Send, or a negative value if an error
+// occurred.
+int SendShort(uint8_t tid, void *msg, size_t msg_len, void *rep, size_t rep_len);
+
 // Receive a message.
 // tid: A pointer to where the task id of the sender is to be stored
 // msg: A pointer to a buffer to store the received message
-// msg_len: The expected message size, in bytes
+// msg_len: The size of the message buffer, in bytes
 //
-// Returns the task id of the sender or a negative value if an error occurred.
+// Only the first msg_len bytes of a longer message are stored.
+// Returns the size of the message sent, which is larger than msg_len if the
+// message was truncated, or a negative value if an error occurred.
 int Receive(uint8_t *tid, void *msg, size_t msg_len);
 
+// Receive a message of at most SYS_CALL_SHORT_MSG_MAX_LEN bytes, carried back
+// in registers rather than copied into msg by the kernel. Arguments are the
+// same as Receive. msg must be word aligned and is written a whole word at a
+// time, so it needs room for msg_len rounded up to a word. Messages from Send
+// and SendShort are both accepted, a longer message is truncated as usual.
+//
+// Returns the size of the message sent like Receive, or -2 if msg_len is too
+// large or msg is not word aligned.
+int ReceiveShort(uint8_t *tid, void *msg, size_t msg_len);
+
+// Receive, giving up after ticks ticks. Returns SYS_CALL_TIMEOUT if no
+// message arrived in time, right away if ticks is 0 or less.
+int ReceiveTimeout(uint8_t *tid, void *msg, size_t msg_len, int ticks);
+
+// Send a message by lending the buffer to the receiver instead of copying it.
+// Arguments are the same as Send. msg must lie within the caller's own stack,
+// it is lent to the receiver until the reply is received.
+//
+// Returns the size of the reply like Send, or a negative value if an error
+// occurred, -3 if msg is not owned by the caller.
+int SendLoan(uint8_t tid, void *msg, size_t msg_len, void *rep, size_t rep_len);
+
+// Receive a message, accepting a lent buffer from the sender if there is one.
+// tid: A pointer to where the task id of the sender is to be stored
+// msg: A pointer to a buffer to store the message if it is not lent
+// msg_len: The size of the message buffer, in bytes
+// loan: Set to the message, either the sender's buffer or msg. A lent
+//       buffer must not be written to and is only valid until the reply.
+//
+// Returns the size of the message sent like Receive. A lent message is never
+// truncated.
+int ReceiveLoan(uint8_t *tid, void *msg, size_t msg_len, void **loan);
+
 // Reply to a message.
 // tid: The task id of the task to reply to
 // rep: A pointer to the reply to send
 // rep_len: The size of the reply, in bytes
 //
+// The reply is truncated to the size of the sender's reply buffer.
 // Returns 0 if no error occurred and a negative value otherwise.
 int Reply(uint8_t tid, void *rep, size_t rep_len);
 
+// Reply to a message and then receive the next one, in a single kernel entry.
+// reply_tid: The task id of the task to reply to
+// rep: A pointer to the reply to send
+// rep_len: The size of the reply, in bytes
+// tid: A pointer to where the task id of the next sender is to be stored
+// msg: A pointer to a buffer to store the received message
+// msg_len: The size of the message buffer, in bytes
+//
+// Returns the size of the message sent like Receive, or a negative value if
+// the reply failed.
+// If the reply fails no message is received.
+int ReplyReceive(uint8_t reply_tid, void *rep, size_t rep_len,
+                 uint8_t *tid, void *msg, size_t msg_len);
+
+// ReplyReceive, accepting a lent buffer for the next message like ReceiveLoan
+int ReplyReceiveLoan(uint8_t reply_tid, void *rep, size_t rep_len,
+                     uint8_t *tid, void *msg, size_t msg_len, void **loan);
+
 // Interrupt Processing
 int AwaitEvent(int eventid);
 
+// AwaitEvent, giving up after ticks ticks. Returns SYS_CALL_TIMEOUT if the
+// event was not raised in time, right away if ticks is 0 or less.
+int AwaitEventTimeout(int eventid, int ticks);
+
+// AwaitEvent for the UART RX events, collecting received bytes into buf
+// instead of returning one. The kernel drains the receive FIFO into buf on
+// each RX or receive timeout interrupt, so the buffer usually fills in one
+// go. Returns the number of bytes received, at most len, or -1 if the event
+// is not an RX event or len is 0.
+int AwaitEventBuf(int eventid, void *buf, size_t len);
+
+// Wait for whichever of the events in event_mask (bit n for event n) is
+// raised first. Stores the event in which and what AwaitEvent would have
+// returned in data. Tasks waiting on the single event are woken before tasks
+// in AwaitAny. Returns 0, -1 if the mask names no valid event, or -2 if one of
+// the events is bound with BindEvent.
+int AwaitAny(uint32_t event_mask, int *which, int *data);
+
+// Deliver eventid to the calling task as a message instead of waking
+// AwaitEvent callers. The event arrives through Receive as an event_msg_t
+// whose sender tid is the caller's own tid, ahead of any queued senders.
+// Replying to your own tid does nothing. Interrupts behind the event are
+// re-enabled on every Receive, as AwaitEvent would. The binding lasts until
+// the task exits and AwaitEvent on a bound event returns -2. Returns 0, -1 if
+// the event is invalid or -2 if another task has bound it.
+int BindEvent(int eventid);
+
 // Stop kernel
 void Quit(void);
 
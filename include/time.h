@@ -4,9 +4,16 @@
 #include <int_types.h>
 
 #define CLOCKS_PER_SEC (983040)
+#define CLOCK_TICKS_PER_SEC (100)           // 10ms ticks
 
 typedef uint64_t clock_t;
 
 clock_t clock(void);
 
+// Returns the number of whole ticks in a clock() value
+uint32_t clock_to_ticks(clock_t clocks);
+
+// Returns the first clock() value in the given tick
+clock_t clock_from_ticks(uint32_t ticks);
+
 #endif // TIME_H_INCLUDED_
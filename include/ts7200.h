@@ -27,6 +27,13 @@
     #define TIMER4_VAL_MASK         0x000000FF
     #define TIMER4_ENABLE_MASK      0x00000100
 
+#define SYSCON_BASE 0x80930000
+
+#define SYSCON_HALT_OFFSET      0x00000008  // read to halt the CPU until an interrupt
+#define SYSCON_DEVICECFG_OFFSET 0x00000080
+    #define DEVICECFG_SHENA_MASK    0x00000001  // enable standby and halt
+#define SYSCON_SWLOCK_OFFSET    0x000000C0  // write SWLOCK_UNLOCK before a locked register
+    #define SWLOCK_UNLOCK           0xAA
 
 #define LED_ADDRESS	0x80840020
 	#define LED_NONE	0x0
@@ -118,5 +125,6 @@
 #define VIC2_TIMER3_INT     19
 #define VIC2_UART1_INT      20
 #define VIC2_UART2_INT      22
+#define VIC2_UART3_INT      23  // unused, raised in software for deferred work
 
 
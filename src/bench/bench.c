@@ -0,0 +1,247 @@
+#include <bench.h>
+
+#include <bwio.h>
+#include <int_types.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys_call.h>
+#include <time.h>
+
+#include <internal/queue.h>
+#include <internal/scheduler.h>
+#include <internal/task_descriptor.h>
+
+#define BENCH_CPU_HZ            200000000ULL    // ARM920T core clock on the EP9302
+#define BENCH_STRING_MAX_SIZE   4096
+#define BENCH_STRING_BYTES      (256 * 1024)    // bytes moved per routine per size class
+#define BENCH_SCHEDULER_PAIRS   65536           // put/get pairs per case
+#define BENCH_SCHEDULER_TASKS   8
+#define BENCH_SYSCALL_CALLS     65536
+
+static const size_t string_sizes[] = {4, 16, 64, 256, 1024, BENCH_STRING_MAX_SIZE};
+
+// word aligned, with slack for the unaligned copies
+static uint32_t string_src[BENCH_STRING_MAX_SIZE / 4 + 1];
+static uint32_t string_dest[BENCH_STRING_MAX_SIZE / 4 + 1];
+
+// compare results are stored here so the calls can't be dropped as unused
+static volatile int string_sink;
+
+// Converts Timer4 clocks taken for count units of work to CPU cycles per unit,
+// scaled by 100 since bwprintf has no floats
+static uint32_t bench_cycles_x100(clock_t clocks, uint32_t count) {
+    return (uint32_t)(clocks * BENCH_CPU_HZ * 100 / CLOCKS_PER_SEC / count);
+}
+
+static void bench_print_x100(uint32_t value) {
+    bwprintf(COM2, "%u.%u%u", value / 100, (value / 10) % 10, value % 10);
+}
+
+void bench_string_main(void) {
+    char *src = (char *)string_src;
+    char *dest = (char *)string_dest;
+    clock_t start;
+
+    // no zero bytes so strncmp runs the full length
+    memset(string_src, 'a', sizeof(string_src));
+    memset(string_dest, 'a', sizeof(string_dest));
+
+    bwprintf(COM2, "string cycles/byte: size memcpy memcpy+1 memset memcmp strncmp\n\r");
+    for (size_t i = 0; i < sizeof(string_sizes) / sizeof(string_sizes[0]); i++) {
+        size_t size = string_sizes[i];
+        uint32_t iterations = BENCH_STRING_BYTES / size;
+        clock_t results[5];
+
+        start = clock();
+        for (uint32_t j = 0; j < iterations; j++) {
+            memcpy(dest, src, size);
+        }
+        results[0] = clock() - start;
+
+        // misaligned destination, falls back to byte copies
+        start = clock();
+        for (uint32_t j = 0; j < iterations; j++) {
+            memcpy(dest + 1, src, size);
+        }
+        results[1] = clock() - start;
+
+        start = clock();
+        for (uint32_t j = 0; j < iterations; j++) {
+            memset(dest, 'a', size);
+        }
+        results[2] = clock() - start;
+
+        start = clock();
+        for (uint32_t j = 0; j < iterations; j++) {
+            string_sink += memcmp(dest, src, size);
+        }
+        results[3] = clock() - start;
+
+        start = clock();
+        for (uint32_t j = 0; j < iterations; j++) {
+            string_sink += strncmp(dest, src, size);
+        }
+        results[4] = clock() - start;
+
+        bwprintf(COM2, "%u", size);
+        for (size_t j = 0; j < sizeof(results) / sizeof(results[0]); j++) {
+            bwprintf(COM2, " ");
+            bench_print_x100(bench_cycles_x100(results[j], iterations * size));
+        }
+        bwprintf(COM2, "\n\r");
+    }
+
+    Exit();
+}
+
+// The scheduler as it was before the two level bitmap, kept to compare against.
+// The entry points are kept out of line so both sides pay for a call, like the
+// real scheduler in its own file.
+typedef struct {
+    uint64_t bitmap;
+    queue_t priority_qs[SCHEDULER_PRIORITY_COUNT];
+} old_scheduler_t;
+
+static uint8_t old_bitmap_leadingzeroes(uint64_t bitmap) {
+    if (bitmap & 0x1ULL) {
+        return 0;
+    } else {
+        uint8_t count = 1;
+        if ((bitmap & 0xFFFFFFFFULL) == 0) {
+            bitmap >>= 32;
+            count += 32;
+        }
+        if ((bitmap & 0xFFFFULL) == 0) {
+            bitmap >>= 16;
+            count += 16;
+        }
+        if ((bitmap & 0xFFULL) == 0) {
+            bitmap >>= 8;
+            count += 8;
+        }
+        if ((bitmap & 0xFULL) == 0) {
+            bitmap >>= 4;
+            count += 4;
+        }
+        if ((bitmap & 0x3ULL) == 0) {
+            bitmap >>= 2;
+            count += 2;
+        }
+        count -= bitmap & 0x1ULL;
+
+        return count;
+    }
+}
+
+static task_descriptor_t * __attribute__ ((noinline)) old_scheduler_get(old_scheduler_t *sch) {
+    if (sch->bitmap == 0) {
+        return NULL;
+    }
+
+    uint8_t idx = old_bitmap_leadingzeroes(sch->bitmap);
+    queue_t *max_queue = &(sch->priority_qs[idx]);
+    task_descriptor_t *ret = queue_get(max_queue);
+
+    if (queue_empty(max_queue)) {
+        sch->bitmap &= ~(1ULL << idx);
+    }
+
+    return ret;
+}
+
+static uint8_t __attribute__ ((noinline)) old_scheduler_put(old_scheduler_t *sch, task_descriptor_t *td) {
+    uint8_t err = queue_put(&(sch->priority_qs[td->priority]), &(td->ready_node));
+
+    if (!err) {
+        sch->bitmap |= (1ULL << td->priority);
+        td->state = READY;
+    }
+
+    return err;
+}
+
+static old_scheduler_t old_sch;
+static scheduler_t new_sch;
+static task_descriptor_t scheduler_tds[BENCH_SCHEDULER_TASKS];
+
+// Puts count tasks and gets them back until pairs puts and gets have been
+// done, returns the Timer4 time taken
+static clock_t bench_old_scheduler(size_t count, uint32_t pairs) {
+    clock_t start = clock();
+    for (uint32_t i = 0; i < pairs; i += count) {
+        for (size_t j = 0; j < count; j++) {
+            old_scheduler_put(&old_sch, &scheduler_tds[j]);
+        }
+        for (size_t j = 0; j < count; j++) {
+            old_scheduler_get(&old_sch);
+        }
+    }
+    return clock() - start;
+}
+
+static clock_t bench_new_scheduler(size_t count, uint32_t pairs) {
+    clock_t start = clock();
+    for (uint32_t i = 0; i < pairs; i += count) {
+        for (size_t j = 0; j < count; j++) {
+            scheduler_put(&new_sch, &scheduler_tds[j]);
+        }
+        for (size_t j = 0; j < count; j++) {
+            scheduler_get(&new_sch);
+        }
+    }
+    return clock() - start;
+}
+
+// Runs count tasks at priorities first, first + step, ... through both
+// schedulers and prints cycles per put/get pair
+static void bench_scheduler_case(uint8_t first, uint8_t step, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        task_descriptor_t *td = &scheduler_tds[i];
+        td->priority = first + i * step;
+        td->quantum = TASK_DESCRIPTOR_DEFAULT_QUANTUM;
+        // already READY, so scheduler_put does no blocked time accounting
+        td->state = READY;
+        queue_node_init(&td->ready_node, td);
+    }
+
+    clock_t old_clocks = bench_old_scheduler(count, BENCH_SCHEDULER_PAIRS);
+    clock_t new_clocks = bench_new_scheduler(count, BENCH_SCHEDULER_PAIRS);
+
+    bwprintf(COM2, "%u tasks from priority %u: old ", count, first);
+    bench_print_x100(bench_cycles_x100(old_clocks, BENCH_SCHEDULER_PAIRS));
+    bwprintf(COM2, " new ");
+    bench_print_x100(bench_cycles_x100(new_clocks, BENCH_SCHEDULER_PAIRS));
+    bwprintf(COM2, "\n\r");
+}
+
+void bench_scheduler_main(void) {
+    old_sch.bitmap = 0;
+    for (size_t i = 0; i < SCHEDULER_PRIORITY_COUNT; i++) {
+        queue_init(&old_sch.priority_qs[i]);
+    }
+    scheduler_init(&new_sch);
+
+    bwprintf(COM2, "scheduler cycles per put/get pair\n\r");
+    bench_scheduler_case(0, 0, 1);
+    bench_scheduler_case(31, 0, 1);
+    bench_scheduler_case(SCHEDULER_PRIORITY_COUNT - 1, 0, 1);
+    bench_scheduler_case(0, SCHEDULER_PRIORITY_COUNT / BENCH_SCHEDULER_TASKS, BENCH_SCHEDULER_TASKS);
+
+    Exit();
+}
+
+void bench_syscall_main(void) {
+    // MyTid does no work in the kernel beyond reading the active task, so
+    // this is the cost of the entry and exit paths and one scheduler pass
+    clock_t start = clock();
+    for (uint32_t i = 0; i < BENCH_SYSCALL_CALLS; i++) {
+        MyTid();
+    }
+    clock_t clocks = clock() - start;
+
+    bwprintf(COM2, "null syscall cycles: ");
+    bench_print_x100(bench_cycles_x100(clocks, BENCH_SYSCALL_CALLS));
+    bwprintf(COM2, "\n\r");
+
+    Exit();
+}
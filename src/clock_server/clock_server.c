@@ -2,8 +2,10 @@
 #include <name_server.h>
 #include <sys_call.h>
 #include <bwio.h>
+#include <bool.h>
 #include <int_types.h>
 #include <stddef.h>
+#include <time.h>
 
 #include <internal/queue.h>
 #include <internal/task_descriptor.h>
@@ -37,8 +39,8 @@ int Delay(int tid, int ticks) {
     clock_server_msg_t msg, rep;
     msg.type = CLOCK_SERVER_MSG_TYPE_DELAY;
     msg.time = ticks;
-    int res = Send(tid, &msg, sizeof(msg), &rep, sizeof(rep));
-    if (res) {
+    int res = SendShort(tid, &msg, sizeof(msg), &rep, sizeof(rep));
+    if (res < 0) {
         bwprintf(COM2, "Send to clock server failed for Delay\n\r");
         return CLOCK_SERVER_INVALID_TID;
     }
@@ -52,8 +54,8 @@ int Delay(int tid, int ticks) {
 int Time(int tid) {
     clock_server_msg_t msg, rep;
     msg.type = CLOCK_SERVER_MSG_TYPE_TIME;
-    int res = Send(tid, &msg, sizeof(msg), &rep, sizeof(rep));
-    if (res) {
+    int res = SendShort(tid, &msg, sizeof(msg), &rep, sizeof(rep));
+    if (res < 0) {
         bwprintf(COM2, "Send to clock server failed for Time\n\r");
         return CLOCK_SERVER_INVALID_TID;
     }
@@ -64,8 +66,8 @@ int DelayUntil(int tid, int ticks) {
     clock_server_msg_t msg, rep;
     msg.type = CLOCK_SERVER_MSG_TYPE_DELAYUNTIL;
     msg.time = ticks;
-    int res = Send(tid, &msg, sizeof(msg), &rep, sizeof(rep));
-    if (res) {
+    int res = SendShort(tid, &msg, sizeof(msg), &rep, sizeof(rep));
+    if (res < 0) {
         bwprintf(COM2, "Send to clock server failed for DelayUntil\n\r");
         return CLOCK_SERVER_INVALID_TID;
     }
@@ -78,7 +80,9 @@ int DelayUntil(int tid, int ticks) {
 
 void clock_server_main(void) {
     uint8_t sender_tid = 0;
+    uint8_t clock_server_tid = MyTid();
     clock_server_msg_t msg, rep;
+    uint32_t start = clock_to_ticks(clock());
     uint32_t ticks = 0;
 
     // init queues and nodes for list of blocked task
@@ -92,37 +96,55 @@ void clock_server_main(void) {
     }
 
     RegisterAs(CLOCK_SERVER_NAME);
-    Create(2, clock_server_notifier_main);
+
+    // ticks arrive as messages from our own tid, there is no notifier
+    if (BindEvent(TICK_EVENT) < 0) {
+        bwprintf(COM2, "Clock server failed to bind the timer event\n\r");
+    }
+    int res = ReceiveShort(&sender_tid, &msg, sizeof(msg));
     do {
-        int res = Receive(&sender_tid, &msg, sizeof(msg));
+        bool reply = false;
         if (res < 0) {
             bwprintf(COM2, "Error occurred while receiving in clock server\n\r");
         }
+        if (sender_tid == clock_server_tid) {
+            msg.type = CLOCK_SERVER_MSG_TYPE_TICK;
+        }
+
+        // there is no periodic tick, time is read off the kernel's timebase
+        ticks = clock_to_ticks(clock()) - start;
+
         switch (msg.type) {
             case CLOCK_SERVER_MSG_TYPE_TICK:
-                Reply(sender_tid, &msg, sizeof(msg));   // unblock notifier ASAP
-                ticks++;
+                reply = true;   // replying to our own tid does nothing
 
-                // check if block task should be made ready
-                if (!queue_empty(&blocked)) {
+                // make ready every blocked task whose time has come
+                while (!queue_empty(&blocked)) {
                     clock_server_blocked_entry_t *front = (clock_server_blocked_entry_t*) queue_peek(&blocked);
-                    if (ticks > front->ticks) {
-                        queue_get(&blocked);
-                        queue_put(&free_list, &front->node);
-                        msg.time = ticks;
-                        Reply(front->tid, &msg, sizeof(msg));
+                    if (ticks <= front->ticks) {
+                        break;
                     }
+                    queue_get(&blocked);
+                    queue_put(&free_list, &front->node);
+                    msg.time = ticks;
+                    Reply(front->tid, &msg, sizeof(msg));
+                }
+
+                // tick again when the next one is due
+                if (!queue_empty(&blocked)) {
+                    clock_server_blocked_entry_t *front = (clock_server_blocked_entry_t*) queue_peek(&blocked);
+                    SetTimer(start + front->ticks + 1);
                 }
                 break;
             case CLOCK_SERVER_MSG_TYPE_TIME:
                 msg.time = ticks;
-                Reply(sender_tid, &msg, sizeof(msg));
+                reply = true;
                 break;
             case CLOCK_SERVER_MSG_TYPE_DELAY:
                 if (msg.time <= 0) {
                     msg.type = CLOCK_SERVER_MSG_TYPE_ERROR;
                     msg.time = 0;
-                    Reply(sender_tid, &msg, sizeof(msg));
+                    reply = true;
                     break;
                 }
                 msg.time += ticks;
@@ -130,11 +152,11 @@ void clock_server_main(void) {
                 if (msg.time <= 0) {
                     msg.type = CLOCK_SERVER_MSG_TYPE_ERROR;
                     msg.time = 0;
-                    Reply(sender_tid, &msg, sizeof(msg));
+                    reply = true;
                 } else if (msg.time < ticks) {
                     msg.type = CLOCK_SERVER_MSG_TYPE_TICK;
                     msg.time = ticks;
-                    Reply(sender_tid, &msg, sizeof(msg));
+                    reply = true;
                 } else {
                     clock_server_blocked_entry_t *new_node_data = (clock_server_blocked_entry_t*)queue_get(&free_list);
                     queue_node_t *new_node = &new_node_data->node;
@@ -162,6 +184,10 @@ void clock_server_main(void) {
                             blocked.elements++;
                         }
                     }
+
+                    if (queue_peek(&blocked) == new_node_data) {
+                        SetTimer(start + new_node_data->ticks + 1);
+                    }
                 }
             case CLOCK_SERVER_MSG_TYPE_EXIT:
                 break;
@@ -169,18 +195,27 @@ void clock_server_main(void) {
                 bwprintf(COM2, "Clock server received unexpected msg type\n\r");
                 break;
         }
-    } while (msg.type != CLOCK_SERVER_MSG_TYPE_EXIT);
+
+        if (msg.type == CLOCK_SERVER_MSG_TYPE_EXIT) {
+            break;
+        } else if (reply) {
+            res = ReplyReceive(sender_tid, &msg, sizeof(msg), &sender_tid, &msg, sizeof(msg));
+            if (res < 0) {
+                // nothing was received, the client may have been destroyed
+                bwprintf(COM2, "Clock server reply error, tid:%d might be blocked\n\r", sender_tid);
+                res = ReceiveShort(&sender_tid, &msg, sizeof(msg));
+            }
+        } else {
+            res = ReceiveShort(&sender_tid, &msg, sizeof(msg));
+        }
+    } while (true);
     rep.type = CLOCK_SERVER_MSG_TYPE_EXIT;
     rep.time = -1;
-    uint8_t exiter_tid = sender_tid;
 
-    // clear out any tasks that aren't the notifier
-    while (msg.type != CLOCK_SERVER_MSG_TYPE_TICK) {
-        Receive(&sender_tid, &msg, sizeof(msg));
-    }
-    Reply(sender_tid, &rep, sizeof(rep));
+    // the binding goes away on Exit
+    SetTimer(-1);
     bwprintf(COM2, "Clock server shutting down\n\r");
-    Reply(exiter_tid, &rep, sizeof(rep));
+    Reply(sender_tid, &rep, sizeof(rep));
     Exit();
 }
 
@@ -188,26 +223,7 @@ void clock_server_exit(uint8_t clock_server_tid) {
     clock_server_msg_t msg, rep;
     msg.type = CLOCK_SERVER_MSG_TYPE_EXIT;
     int res = Send(clock_server_tid, &msg, sizeof(msg), &rep, sizeof(rep));
-    if (res) {
+    if (res < 0) {
         bwprintf(COM2, "Error shutting down clock server\n\r");
     }
 }
-
-// Blocks until interrupt event occurs, sends message to clock_server when an
-// interrupt is received. Done nothing with reply
-void clock_server_notifier_main(void) {
-    clock_server_msg_t msg, rep;
-    msg.type = CLOCK_SERVER_MSG_TYPE_TICK;
-    int clock_server_tid;
-    clock_server_tid = WhoIs(CLOCK_SERVER_NAME);
-
-    rep.type = CLOCK_SERVER_MSG_TYPE_TICK;
-
-    while (rep.type != CLOCK_SERVER_MSG_TYPE_EXIT) {
-        AwaitEvent(TICK_EVENT);
-        Send(clock_server_tid, &msg, sizeof(msg), &rep, sizeof(rep));
-    }
-
-    bwprintf(COM2, "Clock server notifier shutting down\n\r");
-    Exit();
-}
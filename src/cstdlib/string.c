@@ -2,6 +2,19 @@
 
 #include <stddef.h>
 
+#define WORD_SIZE       sizeof(uint32_t)
+#define WORD_MASK       (WORD_SIZE - 1)
+#define BURST_SIZE      (8 * WORD_SIZE)     // bytes moved by one ldm/stm pair
+
+#define ONES_WORD       0x01010101UL
+#define HIGHS_WORD      0x80808080UL
+
+// non-zero if any byte in the word is zero
+#define HAS_ZERO_BYTE(word) (((word) - ONES_WORD) & ~(word) & HIGHS_WORD)
+
+// true if both pointers have the same offset from a word boundary
+#define SAME_ALIGNMENT(a, b) ((((uintptr_t)(a) ^ (uintptr_t)(b)) & WORD_MASK) == 0)
+
 char *strncpy(char *dest, const char *src, size_t count) {
     size_t i = 0;
 
@@ -18,6 +31,29 @@ char *strncpy(char *dest, const char *src, size_t count) {
 int strncmp(const char *lhs, const char *rhs, size_t count) {
     int ret = 0;
 
+    // compare a word at a time while neither string has ended
+    if (SAME_ALIGNMENT(lhs, rhs)) {
+        while (((uintptr_t)lhs & WORD_MASK) && count > 0) {
+            ret = *lhs - *rhs;
+            if (ret || *lhs == 0) {
+                return ret;
+            }
+            lhs++;
+            rhs++;
+            count--;
+        }
+
+        const uint32_t *lhs_word = (const uint32_t *)lhs;
+        const uint32_t *rhs_word = (const uint32_t *)rhs;
+        while (count >= WORD_SIZE && *lhs_word == *rhs_word && !HAS_ZERO_BYTE(*lhs_word)) {
+            lhs_word++;
+            rhs_word++;
+            count -= WORD_SIZE;
+        }
+        lhs = (const char *)lhs_word;
+        rhs = (const char *)rhs_word;
+    }
+
     for (size_t i = 0; i < count; i++) {
         ret = lhs[i] - rhs[i];
         if (ret || lhs[i] == 0) {
@@ -30,9 +66,27 @@ int strncmp(const char *lhs, const char *rhs, size_t count) {
 
 void *memchr(const void *ptr, int ch, size_t count) {
     const unsigned char *byte_ptr = (const unsigned char *)ptr;
+    unsigned char byte = (unsigned char)ch;
 
-    for (int i = 0; i < count; ++i) {
-        if (byte_ptr[i] == (unsigned char)ch) {
+    while (((uintptr_t)byte_ptr & WORD_MASK) && count > 0) {
+        if (*byte_ptr == byte) {
+            return (void *)byte_ptr;
+        }
+        byte_ptr++;
+        count--;
+    }
+
+    // skip words that don't contain the byte
+    const uint32_t *word_ptr = (const uint32_t *)byte_ptr;
+    uint32_t pattern = byte * ONES_WORD;
+    while (count >= WORD_SIZE && !HAS_ZERO_BYTE(*word_ptr ^ pattern)) {
+        word_ptr++;
+        count -= WORD_SIZE;
+    }
+    byte_ptr = (const unsigned char *)word_ptr;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (byte_ptr[i] == byte) {
             return (void *)&byte_ptr[i];
         }
     }
@@ -44,7 +98,29 @@ int memcmp(const void *lhs, const void *rhs, size_t count) {
     const unsigned char *lhs_byte_ptr = (const unsigned char *)lhs;
     const unsigned char *rhs_byte_ptr = (const unsigned char *)rhs;
 
-    for (int i = 0; i < count; ++i) {
+    // skip equal words, the differing word is compared a byte at a time below
+    if (SAME_ALIGNMENT(lhs_byte_ptr, rhs_byte_ptr)) {
+        while (((uintptr_t)lhs_byte_ptr & WORD_MASK) && count > 0) {
+            if (*lhs_byte_ptr != *rhs_byte_ptr) {
+                return (*lhs_byte_ptr < *rhs_byte_ptr) ? -1 : 1;
+            }
+            lhs_byte_ptr++;
+            rhs_byte_ptr++;
+            count--;
+        }
+
+        const uint32_t *lhs_word_ptr = (const uint32_t *)lhs_byte_ptr;
+        const uint32_t *rhs_word_ptr = (const uint32_t *)rhs_byte_ptr;
+        while (count >= WORD_SIZE && *lhs_word_ptr == *rhs_word_ptr) {
+            lhs_word_ptr++;
+            rhs_word_ptr++;
+            count -= WORD_SIZE;
+        }
+        lhs_byte_ptr = (const unsigned char *)lhs_word_ptr;
+        rhs_byte_ptr = (const unsigned char *)rhs_word_ptr;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
         if (lhs_byte_ptr[i] < rhs_byte_ptr[i]) {
             return -1;
         } else if (lhs_byte_ptr[i] > rhs_byte_ptr[i]) {
@@ -58,7 +134,39 @@ int memcmp(const void *lhs, const void *rhs, size_t count) {
 void *memset(void *dest, int ch, size_t count) {
     unsigned char *byte_ptr = (unsigned char *)dest;
 
-    for (int i = 0; i < count; ++i) {
+    while (((uintptr_t)byte_ptr & WORD_MASK) && count > 0) {
+        *byte_ptr++ = (unsigned char)ch;
+        count--;
+    }
+
+    uint32_t *word_ptr = (uint32_t *)byte_ptr;
+    uint32_t pattern = (unsigned char)ch * ONES_WORD;
+
+    // fill 32 byte blocks with two 4 register stores each
+    size_t bursts = count / BURST_SIZE;
+    if (bursts > 0) {
+        __asm__ volatile ("mov r3, %2\n\t"
+                          "mov r4, %2\n\t"
+                          "mov r5, %2\n\t"
+                          "mov ip, %2\n"
+                          "1:\n\t"
+                          "stmia %0!, {r3, r4, r5, ip}\n\t"
+                          "stmia %0!, {r3, r4, r5, ip}\n\t"
+                          "subs %1, %1, #1\n\t"
+                          "bne 1b\n\t"
+                          : "+r" (word_ptr), "+r" (bursts)
+                          : "r" (pattern)
+                          : "r3", "r4", "r5", "ip", "cc", "memory");
+        count &= BURST_SIZE - 1;
+    }
+
+    while (count >= WORD_SIZE) {
+        *word_ptr++ = pattern;
+        count -= WORD_SIZE;
+    }
+
+    byte_ptr = (unsigned char *)word_ptr;
+    for (size_t i = 0; i < count; ++i) {
         byte_ptr[i] = (unsigned char)ch;
     }
 
@@ -67,10 +175,42 @@ void *memset(void *dest, int ch, size_t count) {
 
 void *memcpy(void *restrict dest, const void *restrict src, size_t count) {
     unsigned char *byte_ptr1 = (unsigned char *)dest;
-    unsigned char *byte_ptr2 = (unsigned char *)src;
+    const unsigned char *byte_ptr2 = (const unsigned char *)src;
+
+    // word copies are only possible if both can be aligned at the same time
+    if (SAME_ALIGNMENT(byte_ptr1, byte_ptr2)) {
+        while (((uintptr_t)byte_ptr1 & WORD_MASK) && count > 0) {
+            *byte_ptr1++ = *byte_ptr2++;
+            count--;
+        }
+
+        uint32_t *word_ptr1 = (uint32_t *)byte_ptr1;
+        const uint32_t *word_ptr2 = (const uint32_t *)byte_ptr2;
+
+        // move 32 byte blocks with an 8 register load/store multiple
+        size_t bursts = count / BURST_SIZE;
+        if (bursts > 0) {
+            __asm__ volatile ("1:\n\t"
+                              "ldmia %1!, {r3, r4, r5, r6, r7, r8, r9, ip}\n\t"
+                              "stmia %0!, {r3, r4, r5, r6, r7, r8, r9, ip}\n\t"
+                              "subs %2, %2, #1\n\t"
+                              "bne 1b\n\t"
+                              : "+r" (word_ptr1), "+r" (word_ptr2), "+r" (bursts)
+                              :
+                              : "r3", "r4", "r5", "r6", "r7", "r8", "r9", "ip", "cc", "memory");
+            count &= BURST_SIZE - 1;
+        }
+
+        while (count >= WORD_SIZE) {
+            *word_ptr1++ = *word_ptr2++;
+            count -= WORD_SIZE;
+        }
+
+        byte_ptr1 = (unsigned char *)word_ptr1;
+        byte_ptr2 = (const unsigned char *)word_ptr2;
+    }
 
-    for (int i = 0; i < count; ++i)
-    {
+    for (size_t i = 0; i < count; ++i) {
         byte_ptr1[i] = byte_ptr2[i];
     }
 
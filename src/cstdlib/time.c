@@ -11,3 +11,11 @@ clock_t clock(void) {
     ret |= (clock_t)(*timer4_value_high_reg & TIMER4_VAL_MASK) << 32;
     return ret;
 }
+
+uint32_t clock_to_ticks(clock_t clocks) {
+    return (uint32_t)(clocks * CLOCK_TICKS_PER_SEC / CLOCKS_PER_SEC);
+}
+
+clock_t clock_from_ticks(uint32_t ticks) {
+    return ((clock_t)ticks * CLOCKS_PER_SEC + CLOCK_TICKS_PER_SEC - 1) / CLOCK_TICKS_PER_SEC;
+}
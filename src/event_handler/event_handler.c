@@ -1,12 +1,25 @@
 #include <internal/event_handler.h>
+#include <internal/trace.h>
 
 #include <bwio.h>
+#include <stddef.h>
+#include <string.h>
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 void event_handler_init(event_handler_t *ctx, scheduler_t *sch) {
     for (int i = 0; i < EVENT_HANDLER_MAX_EVENTS; ++i) {
-        queue_init(&ctx->await_qs[i]);
+        ctx->events[i].bound = NULL;
+        ctx->events[i].waiter = NULL;
+        queue_init(&ctx->events[i].await_q);
+        ctx->events[i].pending = 0;
+        ctx->events[i].read_index = 0;
     }
+    queue_init(&ctx->any_q);
+    ctx->blocked_count = 0;
+    ctx->bound_count = 0;
     ctx->sch = sch;
+    ctx->irq_time = 0;
 }
 
 int event_handler_add_task(event_handler_t *ctx, event_t event, task_descriptor_t *td) {
@@ -14,33 +27,234 @@ int event_handler_add_task(event_handler_t *ctx, event_t event, task_descriptor_
         return -1;
     }
 
+    event_handler_event_t *e = &ctx->events[event];
+    if (!e->waiter) {
+        // the common case, a single notifier per event
+        e->waiter = td;
+    } else if (queue_put(&e->await_q, &td->await_node)) {
+        return -2;
+    }
+
+    td->state = EVENT_BLOCKED;
+    ctx->blocked_count++;
+    return 0;
+}
+
+int event_handler_add_any(event_handler_t *ctx, uint32_t mask, task_descriptor_t *td) {
+    if (mask == 0 || (mask >> EVENT_HANDLER_MAX_EVENTS) != 0) {
+        return -1;
+    }
+
+    td->event_params.any_mask = mask;
+    queue_put(&ctx->any_q, &td->await_node);
     td->state = EVENT_BLOCKED;
-    if (!queue_put(&ctx->await_qs[event], &td->await_node)) {
+    ctx->blocked_count++;
+    return 0;
+}
+
+int event_handler_remove_task(event_handler_t *ctx, task_descriptor_t *td) {
+    if (td->event_params.any_mask) {
+        if (queue_remove(&ctx->any_q, &td->await_node)) {
+            return -1;
+        }
+        ctx->blocked_count--;
         return 0;
     }
 
-    return -2;
+    for (int i = 0; i < EVENT_HANDLER_MAX_EVENTS; ++i) {
+        event_handler_event_t *e = &ctx->events[i];
+        if (e->waiter == td) {
+            e->waiter = queue_get(&e->await_q);
+        } else if (queue_remove(&e->await_q, &td->await_node)) {
+            continue;
+        }
+
+        ctx->blocked_count--;
+        return 0;
+    }
+
+    return -1;
 }
 
-int event_handler_handle_event(event_handler_t *ctx, event_t event, int ret) {
+// Returns the longest waiting task in AwaitAny on event, unlinked, or NULL
+static task_descriptor_t *event_handler_get_any(event_handler_t *ctx, event_t event) {
+    for (queue_node_t *node = ctx->any_q.front; node; node = node->next) {
+        task_descriptor_t *td = node->data;
+        if (td->event_params.any_mask & (1 << event)) {
+            queue_remove(&ctx->any_q, node);
+            return td;
+        }
+    }
+
+    return NULL;
+}
+
+static void event_handler_resume(event_handler_t *ctx, task_descriptor_t *td, event_t event, int ret) {
+    ctx->blocked_count--;
+
+    if (td->event_params.any_mask) {
+        *td->event_params.which = event;
+        *td->event_params.data = ret;
+        td->event_params.any_mask = 0;
+        ret = 0;
+    }
+
+    task_descriptor_set_return_value(td, ret);
+    td->wake_event = event;
+    td->wake_time = ctx->irq_time;
+    scheduler_put(ctx->sch, td);
+    trace_record(TRACE_WAKEUP, td->tid, event, ret, 0);
+}
+
+int event_handler_bind(event_handler_t *ctx, event_t event, task_descriptor_t *td) {
     if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS) {
         return -1;
     }
 
-    while (!queue_empty(&ctx->await_qs[event])) {
-        task_descriptor_t *td = queue_get(&ctx->await_qs[event]);
-        task_descriptor_set_return_value(td, ret);
-        scheduler_put(ctx->sch, td);
+    if (ctx->events[event].bound && ctx->events[event].bound != td) {
+        return -2;
     }
 
+    if (!ctx->events[event].bound) {
+        ctx->events[event].bound = td;
+        ctx->bound_count++;
+    }
+    td->bound_events |= 1 << event;
     return 0;
 }
 
-bool event_handler_empty(event_handler_t *ctx) {
+void event_handler_unbind_task(event_handler_t *ctx, task_descriptor_t *td) {
     for (int i = 0; i < EVENT_HANDLER_MAX_EVENTS; ++i) {
-        if (!queue_empty(&ctx->await_qs[i])) {
-            return false;
+        if (ctx->events[i].bound == td) {
+            ctx->events[i].bound = NULL;
+            ctx->bound_count--;
         }
     }
+    td->bound_events = 0;
+}
+
+bool event_handler_bound(event_handler_t *ctx, event_t event) {
+    return event >= 0 && event < EVENT_HANDLER_MAX_EVENTS && ctx->events[event].bound;
+}
+
+int event_handler_store_msg(event_t event, int data, void *msg, size_t msg_len, void **loan) {
+    event_msg_t event_msg = { event, data };
+
+    if (loan) {
+        *loan = msg;
+    }
+    memcpy(msg, &event_msg, MIN(msg_len, sizeof(event_msg)));
+    return sizeof(event_msg);
+}
+
+// Completes a bound task's Receive with the event, sent from its own tid
+static void event_handler_deliver(event_handler_t *ctx, task_descriptor_t *td, event_t event, int ret) {
+    *td->message_params.tid = td->tid;
+    task_descriptor_set_return_value(td, event_handler_store_msg(event, ret, td->message_params.msg,
+                                                                 td->message_params.msg_len,
+                                                                 td->message_params.loan_dest));
+    td->wake_event = event;
+    td->wake_time = ctx->irq_time;
+    scheduler_put(ctx->sch, td);
+    trace_record(TRACE_WAKEUP, td->tid, event, ret, 0);
+}
+
+static void event_handler_wake(event_handler_t *ctx, event_t event, int ret) {
+    event_handler_event_t *e = &ctx->events[event];
+    task_descriptor_t *td = e->waiter;
+    e->waiter = queue_get(&e->await_q);
+    event_handler_resume(ctx, td, event, ret);
+}
+
+int event_handler_handle_event(event_handler_t *ctx, event_t event, int ret) {
+    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS) {
+        return -1;
+    }
+
+    event_handler_event_t *e = &ctx->events[event];
+    if (e->bound) {
+        if (e->bound->state == SEND_BLOCKED) {
+            event_handler_deliver(ctx, e->bound, event, ret);
+            return 0;
+        }
+    } else if (e->waiter) {
+        event_handler_wake(ctx, event, ret);
+        return 0;
+    } else {
+        task_descriptor_t *td = event_handler_get_any(ctx, event);
+        if (td) {
+            event_handler_resume(ctx, td, event, ret);
+            return 0;
+        }
+    }
+
+    if (e->pending == EVENT_HANDLER_QUEUE_SIZE) {
+        return -2;
+    }
+    e->data[(e->read_index + e->pending) & (EVENT_HANDLER_QUEUE_SIZE - 1)] = ret;
+    e->pending++;
+    return 0;
+}
+
+int event_handler_wake_first(event_handler_t *ctx, event_t event, int ret) {
+    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS || !ctx->events[event].waiter) {
+        return -1;
+    }
+
+    event_handler_wake(ctx, event, ret);
+    return 0;
+}
+
+task_descriptor_t *event_handler_peek(event_handler_t *ctx, event_t event) {
+    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS) {
+        return NULL;
+    }
+
+    return ctx->events[event].waiter;
+}
+
+bool event_handler_waiting(event_handler_t *ctx, event_t event) {
+    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS) {
+        return false;
+    }
+
+    if (ctx->events[event].bound || ctx->events[event].waiter) {
+        return true;
+    }
+
+    for (queue_node_t *node = ctx->any_q.front; node; node = node->next) {
+        if (((task_descriptor_t *)node->data)->event_params.any_mask & (1 << event)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool event_handler_full(event_handler_t *ctx, event_t event) {
+    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS ||
+        ctx->events[event].pending < EVENT_HANDLER_QUEUE_SIZE) {
+        return false;
+    }
+
+    // a bound event only skips the queue while its task is in Receive
+    if (ctx->events[event].bound) {
+        return ctx->events[event].bound->state != SEND_BLOCKED;
+    }
+    return !event_handler_waiting(ctx, event);
+}
+
+bool event_handler_take(event_handler_t *ctx, event_t event, int *ret) {
+    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS || ctx->events[event].pending == 0) {
+        return false;
+    }
+
+    event_handler_event_t *e = &ctx->events[event];
+    *ret = e->data[e->read_index];
+    e->read_index = (e->read_index + 1) & (EVENT_HANDLER_QUEUE_SIZE - 1);
+    e->pending--;
     return true;
 }
+
+bool event_handler_empty(event_handler_t *ctx) {
+    return ctx->blocked_count == 0 && ctx->bound_count == 0;
+}
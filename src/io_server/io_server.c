@@ -8,12 +8,13 @@
 #include <stddef.h>
 #include <string.h>
 
+#define NOTIFIER_STACK_SIZE 0x400
+
 void static io_server_notifier_rx_main(void) {
     uint8_t io_server_tid = 0;
     uint8_t sender_tid;
     io_server_msg_t msg, rep;
     msg.type = IO_SERVER_MSG_TYPE_NOTIF_RX;
-    msg.len = 1;
     uint8_t com_num;
     volatile uint32_t *uart_base = 0;
     event_t rx_event = SYS_CALL_EVENT_UART2_RX;
@@ -44,13 +45,14 @@ void static io_server_notifier_rx_main(void) {
     io_server_tid = WhoIs(io_server_name);
 
     do {
-        int data = AwaitEvent(rx_event);
+        // forward whatever the kernel drained from the FIFO in one message
+        res = AwaitEventBuf(rx_event, msg.data, IO_SERVER_MSG_MAX_DATA_LEN);
         if (res < 0) {
             panic("rx notifier failed to await event");
         }
-        msg.data[0] = data;
+        msg.len = res;
 
-        int res = Send(io_server_tid, &msg, sizeof(msg), &rep, sizeof(rep));
+        res = SendLoan(io_server_tid, &msg, IO_SERVER_MSG_SIZE(msg.len), &rep, sizeof(rep));
         if (res < 0) {
             panic("Send to io server failed\n\r");
             rep.type = IO_SERVER_MSG_TYPE_NOTIF_RX;
@@ -120,7 +122,7 @@ void static io_server_notifier_tx_main(void) {
             uart_base = (volatile uint32_t*) UART1_BASE;
             io_server_name = IO_SERVER_NAME1;
             tx_event = SYS_CALL_EVENT_UART1_TX;
-            cts_notifier_tid = Create(1, io_server_notifier_cts_main);
+            cts_notifier_tid = CreateEx(1, io_server_notifier_cts_main, NOTIFIER_STACK_SIZE);
             Send(cts_notifier_tid, NULL, 0, NULL, 0);
 
             break;
@@ -137,10 +139,10 @@ void static io_server_notifier_tx_main(void) {
     io_server_tid = WhoIs(io_server_name);
 
     do {
-        // pass msg buffer to hardware one char at a time
+        // pass msg buffer to hardware, one char per CTS on the train line
         if (com_num == COM1) {
             // bwprintf(COM2, "%d\n\r", rep.len);
-            for (int i = 0;i < rep.len; i++) {
+            for (size_t i = 0; i < rep.len; i++) {
                 res = AwaitEvent(tx_event);
                 Receive(&cts_notifier_tid, NULL, 0);
                 Reply(cts_notifier_tid, NULL, 0);
@@ -150,18 +152,24 @@ void static io_server_notifier_tx_main(void) {
                 *(uart_base + UART_DATA_OFFSET) = 0xFF & rep.data[i];
             }
         } else {
-            for (int i = 0;i < rep.len; i++) {
-                res = AwaitEvent(tx_event);
-                if (res < 0) {
-                    panic("tx notifier failed to await event");
+            // fill the FIFO while it has room, only wait for it to drain
+            volatile uint32_t *uart_flags = (volatile uint32_t *)((uintptr_t)uart_base + UART_FLAG_OFFSET);
+            for (size_t i = 0; i < rep.len;) {
+                while (i < rep.len && !(*uart_flags & TXFF_MASK)) {
+                    *(uart_base + UART_DATA_OFFSET) = 0xFF & rep.data[i++];
+                }
+                if (i < rep.len) {
+                    res = AwaitEvent(tx_event);
+                    if (res < 0) {
+                        panic("tx notifier failed to await event");
+                    }
                 }
-                *(uart_base + UART_DATA_OFFSET) = 0xFF & rep.data[i];
             }
         }
         rep.len = 0;
 
         // done transmitting
-        int res = Send(io_server_tid, &msg, sizeof(msg), &rep, sizeof(rep));
+        int res = SendLoan(io_server_tid, &msg, IO_SERVER_MSG_SIZE(msg.len), &rep, sizeof(rep));
         if (res < 0) {
             panic("Send to io server failed\n\r");
             rep.len = 0;
@@ -174,7 +182,7 @@ void static io_server_notifier_tx_main(void) {
 
 // entry point for io server
 void static io_server_main(void) {
-    io_server_msg_t msg;
+    io_server_msg_t msg, rep, *req;
     uint8_t sender_tid, tx_notifier_tid, rx_notifier_tid;
     uint8_t in_buf[IO_SERVER_BUFFER_SIZE], out_buf[IO_SERVER_BUFFER_SIZE];
     ringbuffer_t rb_in, rb_out;
@@ -206,8 +214,8 @@ void static io_server_main(void) {
     }
 
     // create notifier tasks
-    tx_notifier_tid = Create(1, io_server_notifier_tx_main);
-    rx_notifier_tid = Create(1, io_server_notifier_rx_main);
+    tx_notifier_tid = CreateEx(1, io_server_notifier_tx_main, NOTIFIER_STACK_SIZE);
+    rx_notifier_tid = CreateEx(1, io_server_notifier_rx_main, NOTIFIER_STACK_SIZE);
     res = Send(tx_notifier_tid, &com_num, sizeof(com_num), NULL, 0);
     if (res < 0) {
         panic("io server failed to send COM number to tx notifier");
@@ -217,13 +225,18 @@ void static io_server_main(void) {
         panic("io server failed to send COM number to rx notifier");
     }
 
+    // requests are received as loans and read in place, replies are built in rep
+    res = ReceiveLoan(&sender_tid, &msg, sizeof(msg), (void **)&req);
     do {
-        int res = Receive(&sender_tid, &msg, sizeof(msg));
+        bool reply = false;
         if (res < 0) {
             panic("IO server error when receiving\n\r");
         }
 
-        switch (msg.type) {
+        rep.type = req->type;
+        rep.len = 0;
+
+        switch (req->type) {
             case IO_SERVER_MSG_TYPE_CLIENT_READ:
                 if (ringbuffer_empty(&rb_in)) {
                     // add ready client
@@ -231,50 +244,48 @@ void static io_server_main(void) {
                     client_tid = sender_tid;
                 } else {
                     // flush buffer contents to receiving client
-                    int len;
-                    for (len = 0;len < msg.len && !ringbuffer_empty(&rb_in);len++) {
-                        msg.data[len] = *ringbuffer_get(&rb_in);
+                    for (rep.len = 0; rep.len < req->len && !ringbuffer_empty(&rb_in); rep.len++) {
+                        rep.data[rep.len] = *ringbuffer_get(&rb_in);
                     }
-                    msg.len = len;
-                    Reply(sender_tid, &msg, sizeof(msg));
+                    reply = true;
                 }
                 break;
             case IO_SERVER_MSG_TYPE_CLIENT_WRITE:
-                if (!ringbuffer_putn(&rb_out, msg.data, msg.len)) {
+                if (!ringbuffer_putn(&rb_out, req->data, req->len)) {
                     panic("Not enough space in ringbuffer!\n\r");
                 } else if (tx_ready) {
                     // send to TX notifier if ready
-                    for (msg.len = 0;
-                            !ringbuffer_empty(&rb_out) && msg.len < IO_SERVER_MSG_MAX_DATA_LEN;
-                            msg.len++) {
-                        msg.data[msg.len] = *ringbuffer_get(&rb_out);
+                    for (rep.len = 0;
+                            !ringbuffer_empty(&rb_out) && rep.len < IO_SERVER_MSG_MAX_DATA_LEN;
+                            rep.len++) {
+                        rep.data[rep.len] = *ringbuffer_get(&rb_out);
                     }
-                    Reply(tx_notifier_tid, &msg, sizeof(msg));
+                    Reply(tx_notifier_tid, &rep, IO_SERVER_MSG_SIZE(rep.len));
                     tx_ready = false;
                 }
-                msg.len = 0;
-                Reply(sender_tid, &msg, sizeof(msg));
+                rep.len = 0;
+                reply = true;
                 break;
             case IO_SERVER_MSG_TYPE_NOTIF_RX:
-                if (!ringbuffer_put(&rb_in, msg.data[0])) {
+                if (!ringbuffer_putn(&rb_in, req->data, req->len)) {
                     panic("Input ringbuffer full!\n\r");
                 } else if (client_ready) {
-                    msg.data[0] = *ringbuffer_get(&rb_in);
-                    msg.len = 1;
-                    Reply(client_tid, &msg, sizeof(msg));
+                    rep.data[0] = *ringbuffer_get(&rb_in);
+                    rep.len = 1;
+                    Reply(client_tid, &rep, IO_SERVER_MSG_SIZE(rep.len));
                     client_ready = false;
                 }
-                msg.len = 0;
-                Reply(sender_tid, &msg, sizeof(msg));
+                rep.len = 0;
+                reply = true;
                 break;
             case IO_SERVER_MSG_TYPE_NOTIF_TX:
-                for (msg.len = 0;
-                        !ringbuffer_empty(&rb_out) && msg.len < IO_SERVER_MSG_MAX_DATA_LEN;
-                        msg.len++) {
-                    msg.data[msg.len] = *ringbuffer_get(&rb_out);
+                for (rep.len = 0;
+                        !ringbuffer_empty(&rb_out) && rep.len < IO_SERVER_MSG_MAX_DATA_LEN;
+                        rep.len++) {
+                    rep.data[rep.len] = *ringbuffer_get(&rb_out);
                 }
-                if (msg.len > 0) {
-                    Reply(sender_tid, &msg, sizeof(msg));
+                if (rep.len > 0) {
+                    reply = true;
                 } else {
                     tx_ready = true;
                 }
@@ -285,7 +296,21 @@ void static io_server_main(void) {
                 panic("IO server received unknown message type\n\r");
                 break;
         }
-    } while (msg.type != IO_SERVER_MSG_TYPE_EXIT);
+
+        if (req->type == IO_SERVER_MSG_TYPE_EXIT) {
+            break;
+        } else if (reply) {
+            res = ReplyReceiveLoan(sender_tid, &rep, IO_SERVER_MSG_SIZE(rep.len),
+                                   &sender_tid, &msg, sizeof(msg), (void **)&req);
+            if (res < 0) {
+                // nothing was received, the client may have been destroyed
+                bwprintf(COM2, "IO server reply error, tid:%d might be blocked\n\r", sender_tid);
+                res = ReceiveLoan(&sender_tid, &msg, sizeof(msg), (void **)&req);
+            }
+        } else {
+            res = ReceiveLoan(&sender_tid, &msg, sizeof(msg), (void **)&req);
+        }
+    } while (true);
 
     // exit notifiers here
     int notifier_exit_count = 0;
@@ -295,7 +320,7 @@ void static io_server_main(void) {
             case IO_SERVER_MSG_TYPE_NOTIF_RX:
             case IO_SERVER_MSG_TYPE_NOTIF_TX:
                 msg.type = IO_SERVER_MSG_TYPE_EXIT;
-                Reply(sender_tid, &msg, sizeof(msg));
+                Reply(sender_tid, &msg, IO_SERVER_MSG_SIZE(0));
                 notifier_exit_count++;
             default:
                 break;
@@ -310,7 +335,7 @@ void io_server_exit(uint8_t io_server_tid) {
     io_server_msg_t msg, rep;
     msg.type = IO_SERVER_MSG_TYPE_EXIT;
     msg.len = 0;
-    int res = Send(io_server_tid, &msg, sizeof(msg), &rep, sizeof(rep));
+    int res = SendLoan(io_server_tid, &msg, IO_SERVER_MSG_SIZE(msg.len), &rep, sizeof(rep));
     if (res < 0) {
         panic("Error occurred shutting down io server\n\r");
     }
@@ -329,7 +354,7 @@ int Getc(int tid, int uart) {
     io_server_msg_t msg, rep;
     msg.type = IO_SERVER_MSG_TYPE_CLIENT_READ;
     msg.len = 1;
-    int res = Send(tid, &msg, sizeof(msg), &rep, sizeof(rep));
+    int res = SendLoan(tid, &msg, IO_SERVER_MSG_SIZE(0), &rep, sizeof(rep));
     if (res < 0) {
         bwprintf(COM2, "Error occurred getting char\n\r");
         return -2;
@@ -342,7 +367,7 @@ int Putc(int tid, int uart, char ch) {
     msg.type = IO_SERVER_MSG_TYPE_CLIENT_WRITE;
     msg.len = 1;
     msg.data[0] = ch;
-    int res = Send(tid, &msg, sizeof(msg), &rep, sizeof(rep));
+    int res = SendLoan(tid, &msg, IO_SERVER_MSG_SIZE(msg.len), &rep, sizeof(rep));
     if (res < 0) {
         bwprintf(COM2, "Error occurred putting char\n\r");
         return -2;
@@ -355,7 +380,7 @@ int Putstr(int tid, int uart, char *str, size_t len) {
     msg.type = IO_SERVER_MSG_TYPE_CLIENT_WRITE;
     msg.len = (len < IO_SERVER_MSG_MAX_DATA_LEN) ? len : IO_SERVER_MSG_MAX_DATA_LEN;
     memcpy(msg.data, str, msg.len);
-    int res = Send(tid, &msg, sizeof(msg), &rep, sizeof(rep));
+    int res = SendLoan(tid, &msg, IO_SERVER_MSG_SIZE(msg.len), &rep, sizeof(rep));
     if (res < 0) {
         bwprintf(COM2, "Error occurred putting str\n\r");
         return -2;
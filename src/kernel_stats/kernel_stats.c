@@ -0,0 +1,125 @@
+#include <internal/kernel_stats.h>
+
+#ifndef KERNEL_STATS_DISABLE
+
+#include <bwio.h>
+#include <string.h>
+
+void kernel_stats_init(kernel_stats_t *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+uint8_t kernel_stats_log2(uint32_t value) {
+    uint8_t ret = 0;
+
+    // no clz on ARMv4, narrow down by halves
+    if (value & 0xFFFF0000) {
+        value >>= 16;
+        ret += 16;
+    }
+    if (value & 0xFF00) {
+        value >>= 8;
+        ret += 8;
+    }
+    if (value & 0xF0) {
+        value >>= 4;
+        ret += 4;
+    }
+    if (value & 0xC) {
+        value >>= 2;
+        ret += 2;
+    }
+    if (value & 0x2) {
+        ret += 1;
+    }
+
+    return ret;
+}
+
+static void kernel_stats_entry_add(kernel_stats_entry_t *entry, uint32_t cycles) {
+    if (entry->count == 0 || cycles < entry->min) {
+        entry->min = cycles;
+    }
+    if (cycles > entry->max) {
+        entry->max = cycles;
+    }
+    entry->count++;
+    entry->total += cycles;
+    entry->histogram[kernel_stats_log2(cycles)]++;
+}
+
+void kernel_stats_record(kernel_stats_t *ctx, uint32_t type, uint32_t cycles) {
+    if (type >= KERNEL_STATS_ENTRY_TYPES) {
+        return;
+    }
+
+    kernel_stats_entry_add(&ctx->entries[type], cycles);
+}
+
+void kernel_stats_record_irq_latency(kernel_stats_t *ctx, event_t event, uint32_t cycles) {
+    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS) {
+        return;
+    }
+
+    kernel_stats_entry_add(&ctx->irq_latency[event], cycles);
+}
+
+void kernel_stats_record_drop(kernel_stats_t *ctx, event_t event) {
+    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS) {
+        return;
+    }
+
+    ctx->dropped[event]++;
+}
+
+static void kernel_stats_entry_dump(kernel_stats_entry_t *entry) {
+    bwprintf(COM2, "count: %u total: %u mean: %u min: %u max: %u\n\r",
+             entry->count, entry->total, entry->total / entry->count, entry->min, entry->max);
+
+    // print non-empty buckets as 2^i:count, bucket i counts [2^i, 2^(i+1))
+    bwprintf(COM2, "        ");
+    for (uint8_t i = 0; i < KERNEL_STATS_BUCKETS; i++) {
+        if (entry->histogram[i]) {
+            bwprintf(COM2, " %u:%u", 1U << i, entry->histogram[i]);
+        }
+    }
+    bwprintf(COM2, "\n\r");
+}
+
+void kernel_stats_dump(kernel_stats_t *ctx) {
+    bwprintf(COM2, "Kernel entries (Timer4 cycles, trap to next activate):\n\r");
+
+    for (uint32_t type = 0; type < KERNEL_STATS_ENTRY_TYPES; type++) {
+        kernel_stats_entry_t *entry = &ctx->entries[type];
+        if (entry->count == 0) {
+            continue;
+        }
+
+        if (type == KERNEL_STATS_IRQ) {
+            bwprintf(COM2, "  irq    ");
+        } else {
+            bwprintf(COM2, "  swi %d ", type);
+        }
+        kernel_stats_entry_dump(entry);
+    }
+
+    bwprintf(COM2, "Interrupt to notifier latency (Timer4 cycles):\n\r");
+
+    for (event_t event = 0; event < EVENT_HANDLER_MAX_EVENTS; event++) {
+        kernel_stats_entry_t *entry = &ctx->irq_latency[event];
+        if (entry->count == 0) {
+            continue;
+        }
+
+        bwprintf(COM2, "  event %d ", event);
+        kernel_stats_entry_dump(entry);
+    }
+
+    for (event_t event = 0; event < EVENT_HANDLER_MAX_EVENTS; event++) {
+        if (ctx->dropped[event]) {
+            bwprintf(COM2, "Event %d dropped %u times, queue full\n\r", event, ctx->dropped[event]);
+        }
+    }
+}
+
+#endif // KERNEL_STATS_DISABLE
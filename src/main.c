@@ -8,19 +8,30 @@
 #include <clock_server.h>
 
 #include <internal/event_handler.h>
+#include <internal/kernel_stats.h>
 #include <internal/mem.h>
+#include <internal/mmu.h>
 #include <internal/queue.h>
 #include <internal/scheduler.h>
+#include <internal/stack_allocator.h>
 #include <internal/sys_codes.h>
 #include <internal/task_descriptor.h>
+#include <internal/trace.h>
 
 #define IDLE_TASK_TID 1
-#define IDLE_TASK_EXIT_OFFSET 0x100
-#define IDLE_TASK_NON_IDLE_TIME_OFFSET 0x104
 
 #define ARG0_OFFSET 0
 #define ARG1_OFFSET 1
 #define ARG2_OFFSET 2
+#define ARG3_OFFSET 3
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// Timer4 and the 508kHz Timer3 clock both divide the 14.7456MHz crystal, by
+// 15 and 29, so Timer4 cycles convert to Timer3 counts exactly
+#define TIMER3_COUNTS(clocks) (((clocks) * 15 + 28) / 29)
+#define TIMER3_MAX_CLOCKS ((clock_t)60 * CLOCKS_PER_SEC)    // rearm after a minute
 
 #define REG(base, offset) (*(volatile uint32_t *)((base) + (offset)))
 
@@ -28,7 +39,16 @@ typedef struct {
     task_descriptor_t *tds;
     scheduler_t *sch;
     event_handler_t *eh;
-    size_t next_free_td;
+    kernel_stats_t *stats;
+    queue_t free_tds;       // descriptors available to Create
+    stack_allocator_t *stacks;
+    struct {
+        bool deadline_set;
+        clock_t deadline;   // Timer4 time the timer event is due
+        bool armed;
+        clock_t expiry;     // Timer4 time Timer3 is set to fire
+        queue_t sleepers;   // tasks with a timeout, soonest first
+    } timer;
     struct {
         uint32_t last_idle_time;
     } metrics;
@@ -36,138 +56,328 @@ typedef struct {
 
 typedef uint32_t kernel_request_t;
 
+#define KERNEL_REQUEST_IRQ 0xFFFFFFFF
+
+// Shared between the kernel and the idle task, which has no way to get at the
+// kernel context
+static volatile struct {
+    bool exit;
+    uint32_t non_idle_time;
+} idle_state;
+
 // Forward declare the first user task. This must be defined elsewhere
 void user_main(void);
 
-// This forward declares the existence of a label named kernel_entry
+// Entry stubs, defined in the asm below
 void kernel_entry(void);
-
-// This forward declares the existence of a label named irq_entry
 void irq_entry(void);
 
-static void activate(task_descriptor_t *td, kernel_request_t *req) {
-    register int sys_code __asm__ ("r2");
-
-    register void *active_sp __asm__ ("r0") = td->sp;
-    register uint32_t active_spsr __asm__ ("r1") = td->spsr;
-    register void *active_svc_lr __asm__ ("r3") = td->svc_lr;
-
-    register void *irq_sp __asm__ ("r4") = (void *)MEM_IRQ_STACK_START;
-
-    // Prepare to exit kernel
-    // Step 1: Save kernel state
-    __asm__("stmfd sp!, {%3-r12, lr}    @ Push all kernel registers onto kernel stack\n\t"
-            "@ Step 2: Install active state\n\t"
-            "msr spsr, %0               @ Store scratch register into SPSR\n\t"
-            "mov lr, %2                 @ Store svc link register into link register\n\t"
-            "mrs r1, cpsr               @ Load CPSR into scratch register\n\t"
-            "orr r1, r1, #0x1F          @ Mask off lowest 5 bits for system mode\n\t"
-            "msr cpsr, r1               @ Store into CPSR to enter system mode\n\t"
-            "bic r1, r1, #0xC           @ Clear bits 2 and 3 (needed later to enter supervisor mode)\n\t"
-            "mov sp, %1                 @ Load active task stack pointer\n\t"
-            "mov r0, #0                 @ Move 0 into scratch register\n\t"
-            "str r0, [%3]               @ Set bottom of irq stack to zero\n\t"
-            "sub r0, %3, #4             @ Move to next stack space so we don't change bottom of stack\n\t"
-            "ldmfd sp!, {r2, r3}        @ Pop 2 active task registers from user stack\n\t"
-            "stmfd r0!, {r2, r3}        @ Push 2 active task registers to irq stack\n\t"
-            "ldmfd sp!, {r2-r12, lr}    @ Pop all active task registers from user stack\n\t"
-            "msr cpsr, r1               @ Store into CPSR to enter supervisor mode\n\t"
-            "ldmfd r0, {r0, r1}         @ Pop 2 active task registers from irq stack\n\t"
-            "movs pc, lr\n\t"
-            :                                   // No output operands
-            : "r" (active_spsr), "r" (active_sp), "r" (active_svc_lr), "r" (irq_sp));
-
-    // IRQ entry point
-    __asm__(".align 2\n\t"
-            ".global irq_entry              @ Export irq_entry\n"
-            "irq_entry:                     @ Here begins irq_entry\n"
-            "   sub lr, lr, #4              @ Subtract 4 from link register\n"
-            "   str lr, [sp]                @ Store irq link register onto irq stack (kills 3 birds with one stone!!)\n"
-            "   mrs lr, spsr                @ Load SPSR into scratch register\n"
-            "   str lr, [sp, #-4]           @ Push SPSR into irq stack\n"
-            "   mrs lr, cpsr                @ Load CPSR into scratch register\n"
-            "   orr lr, lr, #0x1            @ Set lowest bit for svc mode\n"
-            "   msr cpsr, lr                @ Store scratch register into CPSR\n\t");
-
-    // Kernel entry point after swi
-    // Step 1: Save arguments passed into function
-    __asm__(".align 2\n\t"
-            ".global kernel_entry           @ Export kernel_entry\n"
-            "kernel_entry:                  @ Here begins kernel_entry\n"
-            "   str lr, [sp, #-4]!          @ Save svc link register into svc stack\n\t"
-
-            "@ Step 2: Save active task state\n\t"
-            "mrs lr, cpsr               @ Load CPSR into scratch register\n\t"
-            "orr lr, lr, #0x1F          @ Mask off lowest 5 bits for system mode\n\t"
-            "msr cpsr, lr               @ Store into CPSR to enter system mode\n\t"
-            "stmfd sp!, {r0-r12, lr}    @ Store all active task registers onto user stack\n\t"
-            "mov %0, sp                 @ Save user stack pointer into scratch register\n\t"
-            "mrs r1, cpsr               @ Load CPSR into scratch register\n\t"
-            "bic r1, r1, #0xC           @ Clear bits 2 and 3 for supervisor mode\n\t"
-            "msr cpsr, r1               @ Store into CPSR to enter supervisor mode\n\t"
-
-            "ldr lr, [sp], #4           @ Restore saved link register (only valid if swi)\n\t"
-            "ldmfd sp!, {r4-r12}        @ Restore kernel state\n\t"
-            "ldr %3, [r4]               @ Load data at bottom of irq stack into scratch register\n\t"
-            "cmp %3, #0                 @ Check if we are handling swi or irq\n\t"
-            "beq swi_label              @ If bottom of irq stack is zero, we're handling swi\n\n\t"
-
-            "ldr %1, [r4, #-4]          @ Load SPSR from irq stack\n\t"
-            "b swi_label_end            @ Done handling irq\n\n"
-
-            "swi_label:                 @ Beginning of handling logic for swi\n\t"
-            "mrs %1, spsr               @ Load SPSR into scratch register\n\t"
-            "@ At this point:\n\t"
-            "@   r0 - Active task stack pointer\n\t"
-            "@   r1 - Active task SPSR\n\t"
-            "@   r3 - Active task link register\n\n\t"
-
-            "@ Step 3: Get swi code\n\t"
-            "ldr r2, [lr, #-4]\n\t"
-            "bic %2, r2, #0xFF000000\n\t"
-            "mov %3, lr\n\n\t"
-
-            "@ At this point:\n\t"
-            "@   r0 - Active task stack pointer\n\t"
-            "@   r1 - Active task SPSR\n\t"
-            "@   r2 - swi code\n\t"
-            "@   r3 - Active task link register\n\n"
-
-            "swi_label_end:                  @ End of branch\n\t"
-            "ldr lr, [sp], #4\n\t"
-            : "=r" (active_sp), "=r" (active_spsr), "=r" (sys_code), "=r" (active_svc_lr));
-
-    td->sp = active_sp;
-    td->spsr = active_spsr;
-    td->svc_lr = active_svc_lr;
-
-    *req = sys_code;
-}
-
-static int kernel_create(kernel_context_t *ctx, task_descriptor_t *active_td, int priority, void (*code) (void)) {
-    if (priority < 0 || priority > 63) {
+// Runs the task whose saved sp, svc_lr and spsr start at context until its
+// next kernel entry, saving them back. Returns the sys code of a swi, which
+// the wrappers pass in ip, or KERNEL_REQUEST_IRQ for an interrupt.
+kernel_request_t task_switch(void **context);
+
+// The task's registers r0-r12 and lr live in a frame on its own stack, the
+// kernel keeps the frame address, the return address and the cpsr. Only the
+// kernel's callee saved registers are kept across a switch. The kernel runs
+// with irqs masked but fiqs open, the fiq handler only touches its own banked
+// registers.
+__asm__(".text\n\t"
+        ".align 2\n\t"
+        ".global task_switch\n"
+        "task_switch:\n\t"
+        "stmfd sp!, {r0, r4-r11, lr}    @ Save context pointer and kernel registers\n\t"
+        "ldmia r0, {r1, r2, r3}         @ Load task sp, return address and cpsr\n\t"
+        "msr spsr_cxsf, r3\n\t"
+        "mov lr, r2\n\t"
+        "msr cpsr_c, #0x9F              @ System mode, irqs off\n\t"
+        "mov sp, r1\n\t"
+        "ldmfd sp!, {r0-r12, lr}        @ Pop task registers off the task stack\n\t"
+        "msr cpsr_c, #0x93              @ Supervisor mode, irqs off\n\t"
+        "movs pc, lr                    @ Return to the task, restoring its cpsr\n\n\t"
+
+        ".global kernel_entry\n"
+        "kernel_entry:                  @ swi: lr is the return address, ip the sys code\n\t"
+        "msr cpsr_c, #0x9F              @ System mode\n\t"
+        "stmfd sp!, {r0-r12, lr}        @ Push task registers onto the task stack\n\t"
+        "mov r0, sp\n\t"
+        "msr cpsr_c, #0x93              @ Supervisor mode\n\t"
+        "mov r1, ip                     @ Request is the sys code\n\t"
+        "b task_switch_return\n\n\t"
+
+        ".global irq_entry\n"
+        "irq_entry:                     @ irq: lr is the return address + 4\n\t"
+        "msr cpsr_c, #0x9F              @ System mode\n\t"
+        "stmfd sp!, {r0-r12, lr}        @ Push task registers onto the task stack\n\t"
+        "mov r0, sp\n\t"
+        "msr cpsr_c, #0x92              @ Back to irq mode for its lr and spsr\n\t"
+        "sub r1, lr, #4\n\t"
+        "mrs r2, spsr\n\t"
+        "msr cpsr_c, #0x93              @ Supervisor mode, set it up like a swi\n\t"
+        "mov lr, r1\n\t"
+        "msr spsr_cxsf, r2\n\t"
+        "mvn r1, #0                     @ Request is KERNEL_REQUEST_IRQ\n\n"
+
+        "task_switch_return:            @ r0 task sp, r1 request, lr and spsr as on a swi\n\t"
+        "ldmfd sp!, {r2}                @ Context pointer\n\t"
+        "mrs r3, spsr\n\t"
+        "stmia r2, {r0, lr, r3}         @ Save task sp, return address and cpsr\n\t"
+        "mov r0, r1\n\t"
+        "ldmfd sp!, {r4-r11, pc}        @ Return the request to the kernel\n\t");
+
+#ifndef UART1_FIQ_DISABLE
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+#define FIQ_LATCH_SIZE 32   // power of two
+#define FIQ_SOFT_INT VIC2_UART3_INT
+
+// UART1 events latched by the fiq handler, info is the interrupt cause
+// shifted up by 8 over the data byte
+typedef struct {
+    uint32_t info;
+    uint32_t time;          // Timer4 low word when the fiq was taken
+} fiq_latch_entry_t;
+
+// Single producer ring, the fiq handler only advances head and the kernel only
+// advances tail
+static volatile struct {
+    uint32_t head;
+    uint32_t tail;
+    fiq_latch_entry_t entries[FIQ_LATCH_SIZE];
+} fiq_latch;
+
+static uint32_t redboot_fiq_vector;
+
+void fiq_entry(void);
+
+// UART1 on fiq: r8 is preloaded with the UART1 base and r9 with fiq_latch,
+// r10-r13 are scratch. Empties the receive FIFO and services the other
+// causes, masking them off like the irq path would, latching each one. Then
+// raises a soft irq so the kernel wakes the notifiers.
+__asm__(".text\n\t"
+        ".align 2\n\t"
+        ".global fiq_entry\n"
+        "fiq_entry:                     @ fiq: lr is the return address + 4\n\t"
+        "ldr r13, =" XSTR(TIMER4_BASE) "\n\t"
+        "ldr r13, [r13]                 @ Timestamp first\n"
+        "0:\n\t"
+        "ldr r10, [r8, #" XSTR(UART_FLAG_OFFSET) "]\n\t"
+        "tst r10, #" XSTR(RXFE_MASK) "\n\t"
+        "bne 1f\n\t"
+        "ldr r11, [r8, #" XSTR(UART_DATA_OFFSET) "]  @ Drain the receive FIFO first\n\t"
+        "and r11, r11, #" XSTR(DATA_MASK) "\n\t"
+        "orr r11, r11, #(" XSTR(RIS_MASK) " << 8)\n\t"
+        "b 3f\n"
+        "1:\n\t"
+        "ldr r10, [r8, #" XSTR(UART_INTR_OFFSET) "]\n\t"
+        "ldr r12, [r8, #" XSTR(UART_CTLR_OFFSET) "]\n\t"
+        "tst r10, #" XSTR(MIS_MASK) "\n\t"
+        "beq 2f\n\t"
+        "bic r12, r12, #" XSTR(MSIEN_MASK) "\n\t"
+        "str r12, [r8, #" XSTR(UART_CTLR_OFFSET) "]\n\t"
+        "str r12, [r8, #" XSTR(UART_INTR_OFFSET) "]  @ Any write clears modem status\n\t"
+        "ldr r11, [r8, #" XSTR(UART_FLAG_OFFSET) "]\n\t"
+        "and r11, r11, #0xFF\n\t"
+        "orr r11, r11, #(" XSTR(MIS_MASK) " << 8)\n\t"
+        "b 3f\n"
+        "2:\n\t"
+        "tst r10, #" XSTR(TIS_MASK) "\n\t"
+        "beq 4f                         @ Nothing left we service\n\t"
+        "bic r12, r12, #" XSTR(TIEN_MASK) "\n\t"
+        "str r12, [r8, #" XSTR(UART_CTLR_OFFSET) "]\n\t"
+        "mov r11, #(" XSTR(TIS_MASK) " << 8)\n"
+        "3:\n\t"
+        "ldmia r9, {r10, r12}           @ Head and tail\n\t"
+        "sub r12, r10, r12\n\t"
+        "cmp r12, #" XSTR(FIQ_LATCH_SIZE) "\n\t"
+        "bhs 0b                         @ Full, drop it\n\t"
+        "and r12, r10, #(" XSTR(FIQ_LATCH_SIZE) " - 1)\n\t"
+        "add r12, r9, r12, lsl #3\n\t"
+        "add r12, r12, #8               @ Skip head and tail\n\t"
+        "stmia r12, {r11, r13}          @ Store info and time\n\t"
+        "add r10, r10, #1\n\t"
+        "str r10, [r9]\n\t"
+        "b 0b\n"
+        "4:\n\t"
+        "ldr r13, =" XSTR(VIC2_BASE) "\n\t"
+        "mov r12, #(1 << " XSTR(FIQ_SOFT_INT) ")\n\t"
+        "str r12, [r13, #" XSTR(VIC_SWI_OFFSET) "]\n\t"
+        "subs pc, lr, #4\n\t"
+        ".ltorg\n\t");
+
+// The fiq handler also writes UART1's control register, keep it out while
+// the kernel updates it
+static inline void kernel_fiq_disable(void) {
+    __asm__ volatile ("msr cpsr_c, #0xD3" : : : "memory");
+}
+
+static inline void kernel_fiq_enable(void) {
+    __asm__ volatile ("msr cpsr_c, #0x93" : : : "memory");
+}
+#else
+static inline void kernel_fiq_disable(void) {}
+static inline void kernel_fiq_enable(void) {}
+#endif // UART1_FIQ_DISABLE
+
+// Returns the task named by tid, or NULL if the tid is unused or stale
+static task_descriptor_t *kernel_lookup(kernel_context_t *ctx, int tid) {
+    if (tid < 0) {
+        return NULL;
+    }
+
+    task_descriptor_t *td = &ctx->tds[TASK_DESCRIPTOR_INDEX(tid)];
+    if (td->tid != tid || td->state == FREE) {
+        return NULL;
+    }
+
+    return td;
+}
+
+static void kernel_inherit_priority(kernel_context_t *ctx, task_descriptor_t *td);
+
+// Changes the effective priority of a task, moving it between ready queues if
+// it is ready and passing the change on to the task it is blocked sending to.
+static void kernel_set_priority(kernel_context_t *ctx, task_descriptor_t *td, uint8_t priority) {
+    if (td->priority == priority) {
+        return;
+    }
+
+    if (td->state == READY) {
+        scheduler_remove(ctx->sch, td);
+        td->priority = priority;
+        scheduler_put(ctx->sch, td);
+    } else {
+        td->priority = priority;
+    }
+
+    if (td->state == RECEIVE_BLOCKED || td->state == REPLY_BLOCKED) {
+        kernel_inherit_priority(ctx, td->blocked_on);
+    }
+}
+
+// Returns the highest priority among tasks linked into queue by send_node
+static uint8_t kernel_queue_priority(queue_t *queue, uint8_t priority) {
+    for (queue_node_t *node = queue->front; node != NULL; node = node->next) {
+        task_descriptor_t *td = (task_descriptor_t *)node->data;
+        if (td->priority < priority) {
+            priority = td->priority;
+        }
+    }
+    return priority;
+}
+
+// Recomputes a server's effective priority as the highest of its own and
+// those of the tasks sending to it or waiting on its reply
+static void kernel_inherit_priority(kernel_context_t *ctx, task_descriptor_t *td) {
+    uint8_t priority = kernel_queue_priority(&td->send_q, td->base_priority);
+    priority = kernel_queue_priority(&td->reply_q, priority);
+    kernel_set_priority(ctx, td, priority);
+}
+
+// Fails every task linked into queue by send_node with -1
+static void kernel_fail_senders(kernel_context_t *ctx, queue_t *queue) {
+    while (!queue_empty(queue)) {
+        task_descriptor_t *sender = (task_descriptor_t *)queue_get(queue);
+        task_descriptor_set_return_value(sender, -1);
+        scheduler_put(ctx->sch, sender);
+    }
+}
+
+static void kernel_cancel_timeout(kernel_context_t *ctx, task_descriptor_t *td);
+
+// Frees the task's descriptor and stack. The task is pulled out of whatever
+// queue it is waiting in, tasks sending to it or waiting on its reply fail
+// with -1, and its tid is retired by moving the descriptor to a new
+// generation.
+static void kernel_reclaim(kernel_context_t *ctx, task_descriptor_t *td) {
+    switch (td->state) {
+        case READY:
+            scheduler_remove(ctx->sch, td);
+            break;
+        case RECEIVE_BLOCKED:
+            queue_remove(&td->blocked_on->send_q, &td->send_node);
+            kernel_inherit_priority(ctx, td->blocked_on);
+            break;
+        case REPLY_BLOCKED:
+            queue_remove(&td->blocked_on->reply_q, &td->send_node);
+            kernel_inherit_priority(ctx, td->blocked_on);
+            break;
+        case EVENT_BLOCKED:
+            event_handler_remove_task(ctx->eh, td);
+            break;
+        default:
+            break;
+    }
+
+    kernel_cancel_timeout(ctx, td);
+    kernel_fail_senders(ctx, &td->send_q);
+    kernel_fail_senders(ctx, &td->reply_q);
+    if (td->bound_events) {
+        event_handler_unbind_task(ctx->eh, td);
+    }
+
+    stack_allocator_free(ctx->stacks, td->stack, td->stack_size);
+
+    td->state = FREE;
+    td->tid = TASK_DESCRIPTOR_NEXT_TID(td->tid);
+    queue_put(&ctx->free_tds, &td->ready_node);
+}
+
+static int kernel_create(kernel_context_t *ctx, task_descriptor_t *active_td, int priority,
+                         void (*code) (void), size_t stack_size) {
+    if (priority < 0 || priority >= SCHEDULER_PRIORITY_COUNT) {
+        scheduler_put(ctx->sch, active_td);
         return -1;
     }
-    if (ctx->next_free_td >= TASK_DESCRIPTOR_MAX_TASKS) {
+
+    if (queue_empty(&ctx->free_tds)) {
+        scheduler_put(ctx->sch, active_td);
         return -2;
     }
 
-    task_descriptor_t *new_task = &ctx->tds[ctx->next_free_td];
-    task_descriptor_init(new_task, ctx->next_free_td, (uint8_t)priority, active_td, code);
+    void *stack = stack_allocator_alloc(ctx->stacks, stack_size);
+    if (!stack) {
+        scheduler_put(ctx->sch, active_td);
+        return -3;
+    }
+
+    task_descriptor_t *new_task = (task_descriptor_t *)queue_get(&ctx->free_tds);
+    task_descriptor_init(new_task, new_task->tid, (uint8_t)priority, active_td->tid, code,
+                         stack, stack_allocator_round(stack_size));
 
     // Add new task to priority queue
     scheduler_put(ctx->sch, new_task);
     scheduler_put(ctx->sch, active_td);
 
-    ctx->next_free_td++;
     return new_task->tid;
 }
 
 static bool kernel_exit(kernel_context_t *ctx, task_descriptor_t *active_td) {
-    active_td->state = EXITED;
+    kernel_reclaim(ctx, active_td);
     return scheduler_empty(ctx->sch);
 }
 
+static int kernel_destroy(kernel_context_t *ctx, task_descriptor_t *active_td, int tid) {
+    task_descriptor_t *td = kernel_lookup(ctx, tid);
+    int ret = 0;
+
+    if (!td) {
+        ret = -1;
+    } else if (td == active_td) {
+        ret = -2;
+    } else if (td->state == REPLY_BLOCKED && td->message_params.loan) {
+        // the receiver may still be reading the lent message off td's stack,
+        // freeing it would hand that memory to the next Create
+        ret = -3;
+    } else {
+        kernel_reclaim(ctx, td);
+    }
+
+    scheduler_put(ctx->sch, active_td);
+    return ret;
+}
+
 static void kernel_pass(kernel_context_t *ctx, task_descriptor_t *active_td) {
     scheduler_put(ctx->sch, active_td);
 }
@@ -179,43 +389,89 @@ static int kernel_mytid(kernel_context_t *ctx, task_descriptor_t *active_td) {
 
 static int kernel_parenttid(kernel_context_t *ctx, task_descriptor_t *active_td) {
     scheduler_put(ctx->sch, active_td);
+    return active_td->parent_tid;
+}
 
-    if (!active_td->parent) {
-        return -1;
+// Copies a message between tasks. Short word-sized messages, such as those
+// carried in saved registers by SendShort, are moved a word at a time.
+static inline void kernel_copy(void *dest, const void *src, size_t len) {
+    if (len <= SYS_CALL_SHORT_MSG_MAX_LEN && !(((uintptr_t)dest | (uintptr_t)src | len) & 0x3)) {
+        uint32_t *dest_word = (uint32_t *)dest;
+        const uint32_t *src_word = (const uint32_t *)src;
+        for (size_t i = 0; i < len / 4; i++) {
+            dest_word[i] = src_word[i];
+        }
+    } else {
+        memcpy(dest, src, len);
     }
+}
 
-    return active_td->parent->tid;
+// Returns true if the buffer lies entirely within the task's own stack
+static bool kernel_task_owns(task_descriptor_t *td, void *buf, size_t len) {
+    uintptr_t start = (uintptr_t)buf;
+    uintptr_t stack_bottom = (uintptr_t)td->stack;
+
+    return start >= stack_bottom && start + len <= stack_bottom + td->stack_size;
+}
+
+// Hands the sender's message to a receiver. If the receiver accepts loans
+// (loan non-NULL) and the sender lent its buffer, the receiver gets a pointer
+// to the sender's buffer and nothing is copied. Otherwise as much of the
+// message as fits in the msg_len byte buffer is copied into msg and loan, if
+// given, points at msg.
+static void kernel_deliver_message(task_descriptor_t *sender, void *msg, size_t msg_len, void **loan) {
+    if (loan) {
+        if (sender->message_params.loan) {
+            *loan = sender->message_params.msg;
+            return;
+        }
+        *loan = msg;
+    }
+    kernel_copy(msg, sender->message_params.msg, MIN(msg_len, sender->message_params.msg_len));
 }
 
 static int kernel_send(kernel_context_t *ctx, task_descriptor_t *active_td,
                        uint8_t tid, void *msg, size_t msg_len,
-                       void *rep, size_t rep_len) {
-    task_descriptor_t *receiver = &ctx->tds[tid];
-    if (receiver->tid != tid) {
+                       void *rep, size_t rep_len, bool loan) {
+    task_descriptor_t *receiver = kernel_lookup(ctx, tid);
+    if (!receiver) {
         // Bad tid
         scheduler_put(ctx->sch, active_td);
         return -1;
     }
 
+    if (loan && !kernel_task_owns(active_td, msg, msg_len)) {
+        // Can only lend buffers the sender owns
+        scheduler_put(ctx->sch, active_td);
+        return -3;
+    }
+
+    active_td->message_params.msg = msg;
+    active_td->message_params.msg_len = msg_len;
+    active_td->message_params.loan = loan;
+    active_td->blocked_on = receiver;
+
     if (receiver->state == SEND_BLOCKED) {
-        if (receiver->message_params.msg_len != msg_len) {
-            // TODO: Sender/receiver size mismatch
-            scheduler_put(ctx->sch, active_td);
-            return -2;
-        }
-        memcpy(receiver->message_params.msg, msg, msg_len);
+        kernel_deliver_message(active_td, receiver->message_params.msg,
+                               receiver->message_params.msg_len,
+                               receiver->message_params.loan_dest);
 
         *receiver->message_params.tid = active_td->tid;
-        task_descriptor_set_return_value(receiver, active_td->tid);
-        scheduler_put(ctx->sch, receiver);
+        task_descriptor_set_return_value(receiver, msg_len);
 
+        queue_put(&receiver->reply_q, &active_td->send_node);
         active_td->state = REPLY_BLOCKED;
     } else {
         queue_put(&receiver->send_q, &active_td->send_node);
         active_td->state = RECEIVE_BLOCKED;
+    }
 
-        active_td->message_params.msg = msg;
-        active_td->message_params.msg_len = msg_len;
+    // the receiver runs at least at the sender's priority until it replies
+    if (active_td->priority < receiver->priority) {
+        kernel_set_priority(ctx, receiver, active_td->priority);
+    }
+    if (active_td->state == REPLY_BLOCKED) {
+        scheduler_put(ctx->sch, receiver);
     }
 
     active_td->message_params.rep = rep;
@@ -224,102 +480,605 @@ static int kernel_send(kernel_context_t *ctx, task_descriptor_t *active_td,
     return 0;
 }
 
+// Short message send. The message and the reply are carried in the saved
+// r1-r3 of the sender, which act as both the message and reply buffers.
+static int kernel_send_short(kernel_context_t *ctx, task_descriptor_t *active_td, uint32_t ctrl) {
+    uint32_t *regs = (uint32_t *)active_td->sp + SHORT_MSG_REG_OFFSET;
+    size_t msg_len = SHORT_MSG_CTRL_MSG_LEN(ctrl);
+    size_t rep_len = SHORT_MSG_CTRL_REP_LEN(ctrl);
+
+    if (msg_len > SYS_CALL_SHORT_MSG_MAX_LEN || rep_len > SYS_CALL_SHORT_MSG_MAX_LEN) {
+        scheduler_put(ctx->sch, active_td);
+        return -2;
+    }
+
+    return kernel_send(ctx, active_td, SHORT_MSG_CTRL_TID(ctrl), regs, msg_len, regs, rep_len, false);
+}
+
+static void kernel_enable_event(event_t event);
+
 static int kernel_receive(kernel_context_t *ctx, task_descriptor_t *active_td,
-                          uint8_t *tid, void *msg, size_t msg_len) {
-    if (!queue_empty(&active_td->send_q)) {
-        task_descriptor_t *sender = (task_descriptor_t *)queue_get(&active_td->send_q);
-        if (sender->message_params.msg_len != msg_len) {
-            // TODO: Sender/receiver size mismatch
+                          uint8_t *tid, void *msg, size_t msg_len, void **loan) {
+    // bound events come ahead of senders, from the receiver's own tid
+    for (event_t event = 0; active_td->bound_events >> event; event++) {
+        int data;
+        if (!(active_td->bound_events & (1 << event))) {
+            continue;
+        }
+
+        kernel_enable_event(event);
+        if (event_handler_take(ctx->eh, event, &data)) {
+            *tid = active_td->tid;
             scheduler_put(ctx->sch, active_td);
-            return -1;
+            return event_handler_store_msg(event, data, msg, msg_len, loan);
         }
-        memcpy(msg, sender->message_params.msg, msg_len);
+    }
+
+    if (!queue_empty(&active_td->send_q)) {
+        task_descriptor_t *sender = (task_descriptor_t *)queue_get(&active_td->send_q);
+        kernel_deliver_message(sender, msg, msg_len, loan);
 
         *tid = sender->tid;
         scheduler_put(ctx->sch, active_td);
 
+        queue_put(&active_td->reply_q, &sender->send_node);
         sender->state = REPLY_BLOCKED;
-        return *tid;
+        return sender->message_params.msg_len;
     } else {
         active_td->state = SEND_BLOCKED;
 
         active_td->message_params.tid = tid;
         active_td->message_params.msg = msg;
         active_td->message_params.msg_len = msg_len;
+        active_td->message_params.loan_dest = loan;
     }
     
     return 0;
 }
 
-static int kernel_reply(kernel_context_t *ctx, task_descriptor_t *active_td,
-                        uint8_t tid, void *rep, size_t rep_len) {
-    task_descriptor_t *reply_receiver = &ctx->tds[tid];
+// Short message receive. The message lands in the saved r1-r3 of the
+// receiver, which act as the message buffer, so a SendShort message is moved
+// from one task's saved registers to the other's.
+static int kernel_receive_short(kernel_context_t *ctx, task_descriptor_t *active_td,
+                                uint8_t *tid, size_t msg_len) {
+    uint32_t *regs = (uint32_t *)active_td->sp + SHORT_MSG_REG_OFFSET;
 
-    if (reply_receiver->tid != tid) {
-        // Bad tid
+    if (msg_len > SYS_CALL_SHORT_MSG_MAX_LEN) {
         scheduler_put(ctx->sch, active_td);
-        return -1;
+        return -2;
     }
 
-    if (reply_receiver->message_params.rep_len != rep_len) {
-        // TODO: Sender / receiver size mismatch
-        scheduler_put(ctx->sch, active_td);
+    return kernel_receive(ctx, active_td, tid, regs, msg_len, NULL);
+}
+
+// Copies the reply into the reply-blocked task, truncating it to the size of
+// the task's reply buffer, and makes it ready. Does not reschedule the
+// replying task. Returns 0 on success, negative on error.
+static int kernel_deliver_reply(kernel_context_t *ctx, uint8_t tid, void *rep, size_t rep_len) {
+    task_descriptor_t *reply_receiver = kernel_lookup(ctx, tid);
+
+    if (!reply_receiver) {
+        // Bad tid
+        return -1;
+    }
+    if (reply_receiver->state != REPLY_BLOCKED) {
         return -2;
     }
-    memcpy(reply_receiver->message_params.rep, rep, rep_len);
 
-    task_descriptor_set_return_value(reply_receiver, 0);
+    // drop any priority inherited from the task being replied to
+    task_descriptor_t *server = reply_receiver->blocked_on;
+    queue_remove(&server->reply_q, &reply_receiver->send_node);
+    if (server->priority != server->base_priority &&
+        reply_receiver->priority <= server->priority) {
+        kernel_inherit_priority(ctx, server);
+    }
+
+    kernel_copy(reply_receiver->message_params.rep, rep,
+                MIN(rep_len, reply_receiver->message_params.rep_len));
+
+    task_descriptor_set_return_value(reply_receiver, rep_len);
     scheduler_put(ctx->sch, reply_receiver);
-    scheduler_put(ctx->sch, active_td);
 
     return 0;
 }
 
-static int kernel_await_event(kernel_context_t *ctx, task_descriptor_t *active_td, event_t event) {
-    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS) {
+static int kernel_reply(kernel_context_t *ctx, task_descriptor_t *active_td,
+                        uint8_t tid, void *rep, size_t rep_len) {
+    // replies to bound event messages go nowhere
+    int ret = tid == active_td->tid ? 0 : kernel_deliver_reply(ctx, tid, rep, rep_len);
+    scheduler_put(ctx->sch, active_td);
+
+    return ret;
+}
+
+static int kernel_reply_receive(kernel_context_t *ctx, task_descriptor_t *active_td,
+                                reply_receive_params_t *params) {
+    int ret = params->reply_tid == active_td->tid ? 0 :
+              kernel_deliver_reply(ctx, params->reply_tid, params->rep, params->rep_len);
+    if (ret < 0) {
+        // Reply failed, don't block the caller in receive
         scheduler_put(ctx->sch, active_td);
-        return -1;
+        return ret;
     }
 
-    // enable UART transmit interrupt when task awaits event on them
+    return kernel_receive(ctx, active_td, params->tid, params->msg, params->msg_len, params->loan);
+}
+
+// Turns on the UART interrupts behind event, they are masked again once the
+// event is raised. UART1 entries left in the fiq latch are drained again.
+static void kernel_enable_event(event_t event) {
+#ifndef UART1_FIQ_DISABLE
+    if ((event == SYS_CALL_EVENT_UART1_RX || event == SYS_CALL_EVENT_UART1_TX ||
+         event == SYS_CALL_EVENT_UART1_MS) && fiq_latch.tail != fiq_latch.head) {
+        REG(VIC2_BASE, VIC_SWI_OFFSET) = 1 << FIQ_SOFT_INT;
+    }
+#endif // UART1_FIQ_DISABLE
+
     switch(event) {
         case SYS_CALL_EVENT_UART1_TX:
+            kernel_fiq_disable();
             REG(UART1_BASE, UART_CTLR_OFFSET) |= TIEN_MASK;
+            kernel_fiq_enable();
             break;
         case SYS_CALL_EVENT_UART2_TX:
             REG(UART2_BASE, UART_CTLR_OFFSET) |= TIEN_MASK;
             break;
         case SYS_CALL_EVENT_UART1_RX:
-            REG(UART1_BASE, UART_CTLR_OFFSET) |= RIEN_MASK;
+            kernel_fiq_disable();
+            REG(UART1_BASE, UART_CTLR_OFFSET) |= RIEN_MASK | RTIEN_MASK;
+            kernel_fiq_enable();
             break;
         case SYS_CALL_EVENT_UART2_RX:
-            REG(UART2_BASE, UART_CTLR_OFFSET) |= RIEN_MASK;
+            REG(UART2_BASE, UART_CTLR_OFFSET) |= RIEN_MASK | RTIEN_MASK;
             break;
         case SYS_CALL_EVENT_UART1_MS:
+            kernel_fiq_disable();
             REG(UART1_BASE, UART_CTLR_OFFSET) |= MSIEN_MASK;
+            kernel_fiq_enable();
             break;
         default:
             break;
     }
+}
 
+// buf is NULL for AwaitEvent, AwaitEventBuf only takes RX events
+static int kernel_await_event(kernel_context_t *ctx, task_descriptor_t *active_td, event_t event,
+                              uint8_t *buf, size_t len) {
+    if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS) {
+        scheduler_put(ctx->sch, active_td);
+        return -1;
+    }
+
+    if (buf && (len == 0 || (event != SYS_CALL_EVENT_UART1_RX && event != SYS_CALL_EVENT_UART2_RX))) {
+        scheduler_put(ctx->sch, active_td);
+        return -1;
+    }
+
+    if (event_handler_bound(ctx->eh, event)) {
+        // the event goes to the bound task's Receive instead
+        scheduler_put(ctx->sch, active_td);
+        return -2;
+    }
+
+    // events raised while nobody was waiting are returned straight away
+    int data;
+    if (buf) {
+        size_t count = 0;
+        while (count < len && event_handler_take(ctx->eh, event, &data)) {
+            buf[count++] = data;
+        }
+        if (count > 0) {
+            scheduler_put(ctx->sch, active_td);
+            return count;
+        }
+    } else if (event_handler_take(ctx->eh, event, &data)) {
+        scheduler_put(ctx->sch, active_td);
+        return data;
+    }
+
+    active_td->event_params.buf = buf;
+    active_td->event_params.len = len;
+    active_td->event_params.count = 0;
+    active_td->event_params.any_mask = 0;
+
+    kernel_enable_event(event);
     event_handler_add_task(ctx->eh, event, active_td);
 
     return 0;
 }
 
+static int kernel_await_any(kernel_context_t *ctx, task_descriptor_t *active_td, uint32_t mask,
+                            int *which, int *data) {
+    if (mask == 0 || (mask >> EVENT_HANDLER_MAX_EVENTS) != 0) {
+        scheduler_put(ctx->sch, active_td);
+        return -1;
+    }
+
+    for (event_t event = 0; event < EVENT_HANDLER_MAX_EVENTS; event++) {
+        if ((mask & (1 << event)) && event_handler_bound(ctx->eh, event)) {
+            // the event goes to the bound task's Receive instead
+            scheduler_put(ctx->sch, active_td);
+            return -2;
+        }
+    }
+
+    // lowest numbered event with something queued first
+    for (event_t event = 0; event < EVENT_HANDLER_MAX_EVENTS; event++) {
+        if ((mask & (1 << event)) && event_handler_take(ctx->eh, event, data)) {
+            *which = event;
+            scheduler_put(ctx->sch, active_td);
+            return 0;
+        }
+    }
+
+    active_td->event_params.buf = NULL;
+    active_td->event_params.which = which;
+    active_td->event_params.data = data;
+
+    for (event_t event = 0; event < EVENT_HANDLER_MAX_EVENTS; event++) {
+        if (mask & (1 << event)) {
+            kernel_enable_event(event);
+        }
+    }
+    event_handler_add_any(ctx->eh, mask, active_td);
+
+    return 0;
+}
+
+static int kernel_bind_event(kernel_context_t *ctx, task_descriptor_t *active_td, event_t event) {
+    scheduler_put(ctx->sch, active_td);
+    return event_handler_bind(ctx->eh, event, active_td);
+}
+
+static int kernel_task_stats(kernel_context_t *ctx, task_descriptor_t *active_td,
+                             uint8_t tid, task_stats_t *stats) {
+    scheduler_put(ctx->sch, active_td);
+
+    task_descriptor_t *td = kernel_lookup(ctx, tid);
+    if (!td) {
+        return -1;
+    }
+
+    *stats = td->stats;
+    stats->stack_size = td->stack_size;
+    stats->stack_used = task_descriptor_stack_used(td);
+    return 0;
+}
+
+static int kernel_set_quantum(kernel_context_t *ctx, task_descriptor_t *active_td, int ticks) {
+    scheduler_put(ctx->sch, active_td);
+
+    if (ticks < 1 || ticks > 255) {
+        return -1;
+    }
+
+    int old_quantum = active_td->quantum;
+    active_td->quantum = (uint8_t)ticks;
+    return old_quantum;
+}
+
+static int kernel_set_timer(kernel_context_t *ctx, task_descriptor_t *active_td, int ticks) {
+    scheduler_put(ctx->sch, active_td);
+
+    ctx->timer.deadline_set = ticks >= 0;
+    if (ctx->timer.deadline_set) {
+        ctx->timer.deadline = clock_from_ticks(ticks);
+    }
+    return 0;
+}
+
+// Puts td on the sleep queue to be woken at timeout. Tasks with the same
+// timeout wake in the order they went to sleep.
+static void kernel_set_timeout(kernel_context_t *ctx, task_descriptor_t *td, clock_t timeout) {
+    queue_node_t *parent = NULL;
+    for (queue_node_t *node = ctx->timer.sleepers.front; node; node = node->next) {
+        if (((task_descriptor_t *)node->data)->timeout > timeout) {
+            break;
+        }
+        parent = node;
+    }
+
+    td->timeout_set = true;
+    td->timeout = timeout;
+    queue_insert_after(&ctx->timer.sleepers, parent, &td->timer_node);
+}
+
+static void kernel_cancel_timeout(kernel_context_t *ctx, task_descriptor_t *td) {
+    if (td->timeout_set) {
+        queue_remove(&ctx->timer.sleepers, &td->timer_node);
+        td->timeout_set = false;
+    }
+}
+
+// Blocks the active task until timeout, or returns straight away if that has
+// already passed
+static int kernel_sleep(kernel_context_t *ctx, task_descriptor_t *active_td, clock_t timeout) {
+    if (timeout <= clock()) {
+        scheduler_put(ctx->sch, active_td);
+        return 0;
+    }
+
+    active_td->state = SLEEPING;
+    kernel_set_timeout(ctx, active_td, timeout);
+    return 0;
+}
+
+static int kernel_receive_timeout(kernel_context_t *ctx, task_descriptor_t *active_td,
+                                  uint8_t *tid, void *msg, size_t msg_len, int ticks) {
+    int ret = kernel_receive(ctx, active_td, tid, msg, msg_len, NULL);
+    if (active_td->state != SEND_BLOCKED) {
+        return ret;
+    }
+
+    if (ticks <= 0) {
+        scheduler_put(ctx->sch, active_td);
+        return SYS_CALL_TIMEOUT;
+    }
+    kernel_set_timeout(ctx, active_td, clock() + (clock_t)ticks * TASK_DESCRIPTOR_TICK_CLOCKS);
+    return ret;
+}
+
+static int kernel_await_event_timeout(kernel_context_t *ctx, task_descriptor_t *active_td,
+                                      event_t event, int ticks) {
+    if (ticks <= 0) {
+        // poll, without turning on an interrupt nobody will wait for
+        int data;
+        scheduler_put(ctx->sch, active_td);
+        if (event < 0 || event >= EVENT_HANDLER_MAX_EVENTS) {
+            return -1;
+        }
+        if (event_handler_bound(ctx->eh, event)) {
+            return -2;
+        }
+        return event_handler_take(ctx->eh, event, &data) ? data : SYS_CALL_TIMEOUT;
+    }
+
+    int ret = kernel_await_event(ctx, active_td, event, NULL, 0);
+    if (active_td->state != EVENT_BLOCKED) {
+        return ret;
+    }
+
+    kernel_set_timeout(ctx, active_td, clock() + (clock_t)ticks * TASK_DESCRIPTOR_TICK_CLOCKS);
+    return ret;
+}
+
+// Wakes every task whose timeout has passed. Sleeping tasks get 0, tasks
+// still blocked in a timed Receive or AwaitEvent give up with
+// SYS_CALL_TIMEOUT.
+static void kernel_expire_timeouts(kernel_context_t *ctx, clock_t now) {
+    while (!queue_empty(&ctx->timer.sleepers)) {
+        task_descriptor_t *td = (task_descriptor_t *)ctx->timer.sleepers.front->data;
+        if (td->timeout > now) {
+            break;
+        }
+
+        queue_get(&ctx->timer.sleepers);
+        td->timeout_set = false;
+
+        switch (td->state) {
+            case SLEEPING:
+                task_descriptor_set_return_value(td, 0);
+                break;
+            case SEND_BLOCKED:
+                task_descriptor_set_return_value(td, SYS_CALL_TIMEOUT);
+                break;
+            case EVENT_BLOCKED:
+                event_handler_remove_task(ctx->eh, td);
+                task_descriptor_set_return_value(td, SYS_CALL_TIMEOUT);
+                break;
+            default:
+                // already woken and waiting to run
+                continue;
+        }
+        scheduler_put(ctx->sch, td);
+    }
+}
+
+// Sets Timer3 as a one shot for whichever comes first of the timer event
+// deadline, the soonest task timeout and the end of the active task's time
+// slice. The slice only matters if another task of the same priority is
+// waiting to run. Timer3 is left off when there is nothing to wait for.
+static void kernel_arm_timer(kernel_context_t *ctx, task_descriptor_t *active_td, clock_t now) {
+    bool armed = ctx->timer.deadline_set;
+    clock_t expiry = ctx->timer.deadline;
+
+    if (!queue_empty(&ctx->timer.sleepers)) {
+        clock_t timeout = ((task_descriptor_t *)ctx->timer.sleepers.front->data)->timeout;
+        if (!armed || timeout < expiry) {
+            expiry = timeout;
+        }
+        armed = true;
+    }
+
+    if (scheduler_has_ready(ctx->sch, active_td->priority)) {
+        clock_t slice_end = now + active_td->slice_left;
+        if (!armed || slice_end < expiry) {
+            expiry = slice_end;
+        }
+        armed = true;
+    }
+
+    if (!armed) {
+        if (ctx->timer.armed) {
+            REG(TIMER3_BASE, CRTL_OFFSET) = 0;
+            ctx->timer.armed = false;
+        }
+        return;
+    }
+    if (ctx->timer.armed && ctx->timer.expiry == expiry) {
+        return;
+    }
+
+    clock_t delay = expiry > now ? expiry - now : 0;
+    if (delay > TIMER3_MAX_CLOCKS) {
+        delay = TIMER3_MAX_CLOCKS;
+    }
+
+    REG(TIMER3_BASE, CRTL_OFFSET) = 0;
+    REG(TIMER3_BASE, LDR_OFFSET) = TIMER3_COUNTS((uint32_t)delay) + 1;
+    REG(TIMER3_BASE, CRTL_OFFSET) = ENABLE_MASK | CLKSEL_MASK;
+    ctx->timer.armed = true;
+    ctx->timer.expiry = expiry;
+}
+
+// Raises event, counting it if it had to be dropped
+static void kernel_raise_event(kernel_context_t *ctx, event_t event, int data) {
+    if (event_handler_handle_event(ctx->eh, event, data) == -2) {
+        kernel_stats_record_drop(ctx->stats, event);
+    }
+}
+
+// Timer3 fired. It is stopped until it is armed again, the timer event is
+// raised if its deadline has passed and tasks whose timeout has passed are
+// woken. The interrupt may only have been for the end of a time slice.
+static void kernel_handle_timer(kernel_context_t *ctx) {
+    REG(TIMER3_BASE, CLR_OFFSET) = 0;
+    REG(TIMER3_BASE, CRTL_OFFSET) = 0;
+    ctx->timer.armed = false;
+
+    clock_t now = clock();
+    if (ctx->timer.deadline_set && now >= ctx->timer.deadline) {
+        ctx->timer.deadline_set = false;
+        kernel_raise_event(ctx, SYS_CALL_EVENT_TIMER, clock_to_ticks(now));
+    }
+    kernel_expire_timeouts(ctx, now);
+}
+
+// Hands a received byte to the task waiting longest on the RX event. A task
+// in AwaitEvent is woken with the byte, one in AwaitEventBuf collects it and
+// is woken once its buffer is full or by kernel_rx_flush. With nobody waiting
+// the byte is queued for the next await.
+static void kernel_rx_byte(kernel_context_t *ctx, event_t event, uint8_t byte) {
+    task_descriptor_t *td = event_handler_peek(ctx->eh, event);
+    if (!td || !td->event_params.buf) {
+        kernel_raise_event(ctx, event, byte);
+        return;
+    }
+
+    td->event_params.buf[td->event_params.count++] = byte;
+    if (td->event_params.count == td->event_params.len) {
+        event_handler_wake_first(ctx->eh, event, td->event_params.count);
+    }
+}
+
+// Wakes a task part way through filling its AwaitEventBuf buffer
+static void kernel_rx_flush(kernel_context_t *ctx, event_t event) {
+    task_descriptor_t *td = event_handler_peek(ctx->eh, event);
+    if (td && td->event_params.buf && td->event_params.count > 0) {
+        event_handler_wake_first(ctx->eh, event, td->event_params.count);
+    }
+}
+
+#ifndef UART1_FIQ_DISABLE
+// Wakes the UART1 notifiers with what the fiq handler latched, in arrival
+// order. Wake latency is measured from the fiq. Draining stops at an entry
+// whose event queue is full, the rest stay latched until kernel_enable_event
+// raises the soft irq again. Returns the last event.
+static int kernel_drain_fiq_latch(kernel_context_t *ctx) {
+    event_t event = SYS_CALL_EVENT_UART1;
+
+    // clear first, a fiq from here on raises it again
+    REG(VIC2_BASE, VIC_SWI_CLEAR_OFFSET) = 1 << FIQ_SOFT_INT;
+
+    while (fiq_latch.tail != fiq_latch.head) {
+        volatile fiq_latch_entry_t *entry = &fiq_latch.entries[fiq_latch.tail % FIQ_LATCH_SIZE];
+        uint32_t cause = entry->info >> 8;
+        event_t entry_event = (cause & RIS_MASK) ? SYS_CALL_EVENT_UART1_RX :
+                              (cause & MIS_MASK) ? SYS_CALL_EVENT_UART1_MS : SYS_CALL_EVENT_UART1_TX;
+
+        if (event_handler_full(ctx->eh, entry_event)) {
+            break;
+        }
+
+        event = entry_event;
+        ctx->eh->irq_time = entry->time;
+        if (event == SYS_CALL_EVENT_UART1_RX) {
+            kernel_rx_byte(ctx, event, entry->info & DATA_MASK);
+        } else if (event == SYS_CALL_EVENT_UART1_MS) {
+            kernel_raise_event(ctx, event, entry->info & DATA_MASK);
+        } else {
+            kernel_raise_event(ctx, event, 0);
+        }
+
+        fiq_latch.tail++;
+    }
+    kernel_rx_flush(ctx, SYS_CALL_EVENT_UART1_RX);
+
+    return event;
+}
+#endif // UART1_FIQ_DISABLE
+
+// Drains the receive FIFO into the tasks waiting on event. Bytes nobody is
+// waiting for, or that would overflow a bound event's queue, stay in the FIFO
+// with the receive interrupts masked until the next AwaitEvent or Receive.
+static void kernel_handle_uart_rx(kernel_context_t *ctx, uint32_t uart_base, event_t event) {
+    while (!(REG(uart_base, UART_FLAG_OFFSET) & RXFE_MASK)) {
+        if (!event_handler_waiting(ctx->eh, event) || event_handler_full(ctx->eh, event)) {
+            REG(uart_base, UART_CTLR_OFFSET) &= ~(RIEN_MASK | RTIEN_MASK);
+            break;
+        }
+        kernel_rx_byte(ctx, event, REG(uart_base, UART_DATA_OFFSET) & DATA_MASK);
+    }
+    kernel_rx_flush(ctx, event);
+}
+
+#ifdef UART1_FIQ_DISABLE
+// Services every asserted UART1 cause, returns the last event raised or -1 if
+// there was none
+static int kernel_handle_uart1(kernel_context_t *ctx) {
+    uint32_t causes = REG(UART1_BASE, UART_INTR_OFFSET);
+    int event = -1;
+
+    if (causes & (RIS_MASK | RTIS_MASK)) {
+        event = SYS_CALL_EVENT_UART1_RX;
+        kernel_handle_uart_rx(ctx, UART1_BASE, event);
+    }
+    if (causes & MIS_MASK) {
+        event = SYS_CALL_EVENT_UART1_MS;
+        REG(UART1_BASE, UART_CTLR_OFFSET) &= ~MSIEN_MASK;
+        REG(UART1_BASE, UART_INTR_OFFSET) = 0;
+        kernel_raise_event(ctx, event, REG(UART1_BASE, UART_FLAG_OFFSET));
+    }
+    if (causes & TIS_MASK) {
+        event = SYS_CALL_EVENT_UART1_TX;
+        REG(UART1_BASE, UART_CTLR_OFFSET) &= ~TIEN_MASK;
+        kernel_raise_event(ctx, event, 0);
+    }
+
+    return event;
+}
+#endif // UART1_FIQ_DISABLE
+
+// Services every asserted UART2 cause, returns the last event raised or -1 if
+// there was none
+static int kernel_handle_uart2(kernel_context_t *ctx) {
+    uint32_t causes = REG(UART2_BASE, UART_INTR_OFFSET);
+    int event = -1;
+
+    if (causes & (RIS_MASK | RTIS_MASK)) {
+        event = SYS_CALL_EVENT_UART2_RX;
+        kernel_handle_uart_rx(ctx, UART2_BASE, event);
+    }
+    if (causes & TIS_MASK) {
+        event = SYS_CALL_EVENT_UART2_TX;
+        REG(UART2_BASE, UART_CTLR_OFFSET) &= ~TIEN_MASK;
+        kernel_raise_event(ctx, event, 0);
+    }
+
+    return event;
+}
+
+// Stops scheduling, handle returns true after a panic so the kernel loop
+// exits even if tasks are made ready again on the way out
 static void kernel_panic(kernel_context_t *ctx, task_descriptor_t *active_td, char *msg) {
-    // TODO more elegant solution
-    ctx->sch->bitmap = 0ULL;
+    scheduler_clear(ctx->sch);
     bwprintf(COM2, "Panic: %s\n\r", msg);
 }
 
 void update_idle_task(kernel_context_t *ctx) {
-    volatile bool *is_exit = (bool *)(MEM_TASK_STACK_START(IDLE_TASK_TID) - IDLE_TASK_EXIT_OFFSET);
-    volatile uint32_t *non_idle_time = (uint32_t *)(MEM_TASK_STACK_START(IDLE_TASK_TID) - IDLE_TASK_NON_IDLE_TIME_OFFSET);
-
-    *is_exit = event_handler_empty(ctx->eh);
+    idle_state.exit = event_handler_empty(ctx->eh) && queue_empty(&ctx->timer.sleepers);
     uint32_t cur_time = clock();
-    *non_idle_time += cur_time - ctx->metrics.last_idle_time;
+    idle_state.non_idle_time += cur_time - ctx->metrics.last_idle_time;
 }
 
 void end_idle_task(kernel_context_t *ctx) {
@@ -327,32 +1086,36 @@ void end_idle_task(kernel_context_t *ctx) {
 }
 
 void idle_main(void) {
-    volatile bool *is_exit = (bool *)(MEM_TASK_STACK_START(IDLE_TASK_TID) - IDLE_TASK_EXIT_OFFSET);
-    volatile uint32_t *non_idle_time = (uint32_t *)(MEM_TASK_STACK_START(IDLE_TASK_TID) - IDLE_TASK_NON_IDLE_TIME_OFFSET);
-
-    while (!(*is_exit));
+    while (!idle_state.exit) {
+        // stop the CPU clock until the next interrupt
+        (void)REG(SYSCON_BASE, SYSCON_HALT_OFFSET);
+    }
     uint32_t cur_time = clock();
-    bwprintf(COM2, "Non-idle time: %u/%u\n\r", *non_idle_time, cur_time);
+    bwprintf(COM2, "Non-idle time: %u/%u\n\r", idle_state.non_idle_time, cur_time);
     Exit();
 }
 
 static bool handle(kernel_context_t *ctx, task_descriptor_t *active_td, kernel_request_t *req) {
 
-    if (*((uint32_t *)MEM_IRQ_STACK_START) == 0) {
+    if (*req != KERNEL_REQUEST_IRQ) {
         int ret = 0;
         send_params_t *send_params;
-        int arg0, arg1, arg2;
+        int arg0, arg1, arg2, arg3;
 
         arg0 = ((int *)active_td->sp)[ARG0_OFFSET];
         arg1 = ((int *)active_td->sp)[ARG1_OFFSET];
         arg2 = ((int *)active_td->sp)[ARG2_OFFSET];
+        arg3 = ((int *)active_td->sp)[ARG3_OFFSET];
 
         switch (*req) {
             case SYS_CODE_PASS:
                 kernel_pass(ctx, active_td);
                 break;
             case SYS_CODE_CREATE:
-                ret = kernel_create(ctx, active_td, arg0, (void (*) (void))arg1);
+                ret = kernel_create(ctx, active_td, arg0, (void (*) (void))arg1, MEM_TASK_STACK_SIZE);
+                break;
+            case SYS_CODE_CREATEEX:
+                ret = kernel_create(ctx, active_td, arg0, (void (*) (void))arg1, (size_t)arg2);
                 break;
             case SYS_CODE_MYTID:
                 ret = kernel_mytid(ctx, active_td);
@@ -361,22 +1124,69 @@ static bool handle(kernel_context_t *ctx, task_descriptor_t *active_td, kernel_r
                 ret = kernel_parenttid(ctx, active_td);
                 break;
             case SYS_CODE_SEND:
+            case SYS_CODE_SENDLOAN:
                 send_params = (send_params_t *)arg0;
                 ret = kernel_send(ctx, active_td, send_params->tid,
                                 send_params->msg, send_params->msg_len,
-                                send_params->rep, send_params->rep_len);
+                                send_params->rep, send_params->rep_len,
+                                *req == SYS_CODE_SENDLOAN);
+                break;
+            case SYS_CODE_SENDSHORT:
+                ret = kernel_send_short(ctx, active_td, (uint32_t)arg0);
                 break;
             case SYS_CODE_RECEIVE:
-                ret = kernel_receive(ctx, active_td, (uint8_t *)arg0, (void *)arg1, (size_t)arg2);
+                ret = kernel_receive(ctx, active_td, (uint8_t *)arg0, (void *)arg1, (size_t)arg2, NULL);
+                break;
+            case SYS_CODE_RECEIVESHORT:
+                ret = kernel_receive_short(ctx, active_td, (uint8_t *)arg0, (size_t)arg1);
+                break;
+            case SYS_CODE_RECEIVETIMEOUT:
+                ret = kernel_receive_timeout(ctx, active_td, (uint8_t *)arg0, (void *)arg1, (size_t)arg2, arg3);
+                break;
+            case SYS_CODE_RECEIVELOAN:
+                ret = kernel_receive(ctx, active_td, (uint8_t *)arg0, (void *)arg1, (size_t)arg2, (void **)arg3);
                 break;
             case SYS_CODE_REPLY:
                 ret = kernel_reply(ctx, active_td, (uint8_t)arg0, (void *)arg1, (size_t)arg2);
                 break;
+            case SYS_CODE_REPLYRECEIVE:
+                ret = kernel_reply_receive(ctx, active_td, (reply_receive_params_t *)arg0);
+                break;
             case SYS_CODE_AWAITEVENT:
-                ret = kernel_await_event(ctx, active_td, (event_t)arg0);
+                ret = kernel_await_event(ctx, active_td, (event_t)arg0, NULL, 0);
+                break;
+            case SYS_CODE_AWAITEVENTBUF:
+                ret = kernel_await_event(ctx, active_td, (event_t)arg0, (uint8_t *)arg1, (size_t)arg2);
+                break;
+            case SYS_CODE_AWAITANY:
+                ret = kernel_await_any(ctx, active_td, arg0, (int *)arg1, (int *)arg2);
+                break;
+            case SYS_CODE_BINDEVENT:
+                ret = kernel_bind_event(ctx, active_td, (event_t)arg0);
+                break;
+            case SYS_CODE_AWAITEVENTTIMEOUT:
+                ret = kernel_await_event_timeout(ctx, active_td, (event_t)arg0, arg1);
+                break;
+            case SYS_CODE_TASKSTATS:
+                ret = kernel_task_stats(ctx, active_td, (uint8_t)arg0, (task_stats_t *)arg1);
+                break;
+            case SYS_CODE_SETQUANTUM:
+                ret = kernel_set_quantum(ctx, active_td, arg0);
+                break;
+            case SYS_CODE_SETTIMER:
+                ret = kernel_set_timer(ctx, active_td, arg0);
+                break;
+            case SYS_CODE_SLEEP:
+                ret = kernel_sleep(ctx, active_td, clock() + (clock_t)MAX(arg0, 0) * TASK_DESCRIPTOR_TICK_CLOCKS);
+                break;
+            case SYS_CODE_SLEEPUNTIL:
+                ret = kernel_sleep(ctx, active_td, clock_from_ticks(MAX(arg0, 0)));
                 break;
             case SYS_CODE_PANIC:
                 kernel_panic(ctx, active_td, (char *)arg0);
+                return true;
+            case SYS_CODE_DESTROY:
+                ret = kernel_destroy(ctx, active_td, (uint8_t)arg0);
                 break;
             case SYS_CODE_EXIT:
                 return kernel_exit(ctx, active_td);
@@ -384,69 +1194,56 @@ static bool handle(kernel_context_t *ctx, task_descriptor_t *active_td, kernel_r
                 return true;
             default:
                 kernel_panic(ctx, active_td, "kernel got unknown SWI sys code");
+                return true;
         }
 
         task_descriptor_set_return_value(active_td, ret);
         return false;
 
     } else {
-        event_t event = REG(VIC2_BASE, VIC_VEC_ADDR_OFFSET);
-
-        // determine interrupt type, get retVal
-        uint8_t UART1_INT_ID_INT_CLR = REG(UART1_BASE, UART_INTR_OFFSET);
-        uint8_t UART2_INT_ID_INT_CLR = REG(UART2_BASE, UART_INTR_OFFSET);
-        event_t single_event = 0;
-        int retVal = 0;
-
-        switch (event) {
-            case SYS_CALL_EVENT_TIMER:
-                event_handler_handle_event(ctx->eh, event, 0);
-                REG(TIMER3_BASE, CLR_OFFSET) = 0;
-                REG(VIC2_BASE, VIC_VEC_ADDR_OFFSET) = 0;
-                break;
-            case SYS_CALL_EVENT_UART1:
-                // responded to in priority order
-                if (UART1_INT_ID_INT_CLR & RIS_MASK) {
-                    single_event = SYS_CALL_EVENT_UART1_RX;
-                    retVal = REG(UART1_BASE, UART_DATA_OFFSET) & DATA_MASK;
-                } else if (UART1_INT_ID_INT_CLR & MIS_MASK) {
-                    single_event = SYS_CALL_EVENT_UART1_MS;
-                    retVal = REG(UART1_BASE, UART_FLAG_OFFSET);
-                    REG(UART1_BASE, UART_CTLR_OFFSET) &= ~MSIEN_MASK;
-                    REG(UART1_BASE, UART_INTR_OFFSET) = 0;
-                } else if (UART1_INT_ID_INT_CLR & TIS_MASK) {
-                    single_event = SYS_CALL_EVENT_UART1_TX;
-                    REG(UART1_BASE, UART_CTLR_OFFSET) &= ~TIEN_MASK;
-                } else {
-                    kernel_panic(ctx, active_td, "handler got unexpected event type");
-                    bwprintf(COM2, "Handler got unexpected event type: %d\n\r", event);
-                }
-
-                REG(VIC2_BASE, VIC_VEC_ADDR_OFFSET) = 0;
-                event_handler_handle_event(ctx->eh, single_event, retVal);
-                break;
-            case SYS_CALL_EVENT_UART2:
-                // responded to in priority order
-                if (UART2_INT_ID_INT_CLR & RIS_MASK) {
-                    single_event = SYS_CALL_EVENT_UART2_RX;
-                    retVal = REG(UART2_BASE, UART_DATA_OFFSET) & DATA_MASK;
-                } else if (UART2_INT_ID_INT_CLR & TIS_MASK) {
-                    single_event = SYS_CALL_EVENT_UART2_TX;
-                    REG(UART2_BASE, UART_CTLR_OFFSET) &= ~TIEN_MASK;
-                } else {
-                    kernel_panic(ctx, active_td, "handler got unexpected event type");
-                    bwprintf(COM2, "Handler got unexpected event type: %d\n\r", event);
-                }
-
-                REG(VIC2_BASE, VIC_VEC_ADDR_OFFSET) = 0;
-                event_handler_handle_event(ctx->eh, single_event, retVal);
-                break;
-            default:
+        // service every pending source, and every cause they assert, before
+        // going back to the task
+        while (REG(VIC2_BASE, VIC_IRQ_STATUS_OFFSET)) {
+            event_t event = REG(VIC2_BASE, VIC_VEC_ADDR_OFFSET);
+            int single_event = -1;
+
+            switch (event) {
+                case SYS_CALL_EVENT_TIMER:
+                    kernel_handle_timer(ctx);
+                    single_event = SYS_CALL_EVENT_TIMER;
+                    break;
+                case SYS_CALL_EVENT_UART1:
+#ifndef UART1_FIQ_DISABLE
+                    // soft interrupt, the fiq handler already serviced the UART
+                    single_event = kernel_drain_fiq_latch(ctx);
+#else
+                    single_event = kernel_handle_uart1(ctx);
+#endif
+                    break;
+                case SYS_CALL_EVENT_UART2:
+                    single_event = kernel_handle_uart2(ctx);
+                    break;
+                default:
+                    break;
+            }
+
+            if (single_event < 0) {
+                // nothing was cleared, looping again would spin
                 kernel_panic(ctx, active_td, "kernel handle got unexpected interrupt");
-                break;
+                bwprintf(COM2, "Unexpected interrupt: %d\n\r", event);
+                return true;
+            }
+
+            REG(VIC2_BASE, VIC_VEC_ADDR_OFFSET) = 0;
+            trace_record(TRACE_IRQ, active_td->tid, event, single_event, 0);
+        }
+
+        if (active_td->slice_left == 0) {
+            // slice used up, rotate behind tasks of the same priority
+            scheduler_put(ctx->sch, active_td);
+        } else {
+            scheduler_put_front(ctx->sch, active_td);
         }
-        
-        scheduler_put(ctx->sch, active_td);
         return false;
     } 
 }
@@ -462,31 +1259,48 @@ void setup_vectored_interrupts(void) {
     // Setup Timer3 as highest priority interrupt
     enable_vectored_interrupt(VIC2_BASE, SYS_CALL_EVENT_TIMER, VIC2_TIMER3_INT, 0);
 
+#ifndef UART1_FIQ_DISABLE
+    // UART1 goes to fiq, the soft interrupt it raises takes its place as
+    // second-highest priority
+    REG(VIC2_BASE, VIC_INT_SELECT_OFFSET) |= 1 << VIC2_UART1_INT;
+    REG(VIC2_BASE, VIC_INT_EN_OFFSET) |= 1 << VIC2_UART1_INT;
+    enable_vectored_interrupt(VIC2_BASE, SYS_CALL_EVENT_UART1, FIQ_SOFT_INT, 1);
+#else
     // Setup UART1 as second-highest priority interrupt
     enable_vectored_interrupt(VIC2_BASE, SYS_CALL_EVENT_UART1, VIC2_UART1_INT, 1);
+#endif
 
     // Setup UART2 as third-highest priority interrupt
     enable_vectored_interrupt(VIC2_BASE, SYS_CALL_EVENT_UART2, VIC2_UART2_INT, 2);
 }
 
-void init(kernel_context_t *ctx, task_descriptor_t *tds, scheduler_t *sch, event_handler_t *eh) {
+// RedBoot's DeviceCfg, put back on the way out
+static uint32_t redboot_devicecfg;
+
+void init(kernel_context_t *ctx, task_descriptor_t *tds, scheduler_t *sch, event_handler_t *eh,
+          stack_allocator_t *stacks, kernel_stats_t *stats) {
     // reset UARTs (needs to be done as other groups leave it in weird state)
     REG(UART1_BASE, UART_LCRL_OFFSET) = 0xBF;
     REG(UART1_BASE, UART_LCRM_OFFSET) = 0x0;
-    REG(UART1_BASE, UART_LCRH_OFFSET) = STP2_MASK | WLEN_MASK;
+    REG(UART1_BASE, UART_LCRH_OFFSET) = STP2_MASK | WLEN_MASK | FEN_MASK;
 
     REG(UART2_BASE, UART_LCRL_OFFSET) = 0x3;
     REG(UART2_BASE, UART_LCRM_OFFSET) = 0x0;
-    REG(UART2_BASE, UART_LCRH_OFFSET) = 0x60;
+    REG(UART2_BASE, UART_LCRH_OFFSET) = WLEN_MASK | FEN_MASK;
 
     // reset 40-bit timer, our timebase
     REG(TIMER4_BASE, TIMER4_VAL_HIGH_OFFSET) = 0;
     REG(TIMER4_BASE, TIMER4_VAL_HIGH_OFFSET) = TIMER4_ENABLE_MASK;
 
-    // reset timer3, our systick
+    // timer3 is a one shot armed by the kernel, there is no periodic tick
     REG(TIMER3_BASE, CRTL_OFFSET) = 0;
-    REG(TIMER3_BASE, LDR_OFFSET) = 10 * (TIMER_SLOW_CLOCK_PER_SEC / 1000); // Set systick to 10ms
-    REG(TIMER3_BASE, CRTL_OFFSET) = ENABLE_MASK | MODE_MASK;
+    ctx->timer.deadline_set = false;
+    ctx->timer.armed = false;
+
+    // allow the idle task to halt the CPU
+    redboot_devicecfg = REG(SYSCON_BASE, SYSCON_DEVICECFG_OFFSET);
+    REG(SYSCON_BASE, SYSCON_SWLOCK_OFFSET) = SWLOCK_UNLOCK;
+    REG(SYSCON_BASE, SYSCON_DEVICECFG_OFFSET) = redboot_devicecfg | DEVICECFG_SHENA_MASK;
 
     // set up exception vectors
     volatile uint32_t *swi_exception_vector = (volatile uint32_t *)0x28;
@@ -495,8 +1309,6 @@ void init(kernel_context_t *ctx, task_descriptor_t *tds, scheduler_t *sch, event
     volatile uint32_t *irq_exception_vector = (volatile uint32_t *)0x38;
     *irq_exception_vector = (uint32_t)irq_entry; // hw interrupt entry
 
-    *((uint32_t *)MEM_IRQ_STACK_START) = 0; // Clear bottom of irq stack
-
     // set up irq stack
     __asm__ volatile ("mrs r0, cpsr                 @ Save cpsr into scratch register\n\t"
                       "bic r0, r0, #0x1F            @ Clear mode bits\n\t"
@@ -510,10 +1322,42 @@ void init(kernel_context_t *ctx, task_descriptor_t *tds, scheduler_t *sch, event
                       : "r" (MEM_IRQ_STACK_START)
                       : "r0");
 
+#ifndef UART1_FIQ_DISABLE
+    // fiq handler, its registers are banked so set them up once here
+    fiq_latch.head = 0;
+    fiq_latch.tail = 0;
+    volatile uint32_t *fiq_exception_vector = (volatile uint32_t *)0x3C;
+    redboot_fiq_vector = *fiq_exception_vector;
+    *fiq_exception_vector = (uint32_t)fiq_entry;
+
+    register uint32_t uart_base __asm__("r0") = UART1_BASE;
+    register uint32_t latch __asm__("r1") = (uint32_t)&fiq_latch;
+    __asm__ volatile ("msr cpsr_c, #0xD1             @ Fiq mode\n\t"
+                      "mov r8, %0\n\t"
+                      "mov r9, %1\n\t"
+                      "msr cpsr_c, #0x93             @ Back to svc mode with fiqs on\n\t"
+                      :
+                      : "r" (uart_base), "r" (latch));
+#endif
+
     // init first task
-    task_descriptor_init(tds, 0, 1, NULL, (void (*)(void))user_main);
+    stack_allocator_init(stacks, MEM_TASK_STACK_REGION_START);
+    task_descriptor_init(tds, 0, 1, -1, (void (*)(void))user_main,
+                    stack_allocator_alloc(stacks, MEM_TASK_STACK_SIZE), MEM_TASK_STACK_SIZE);
     task_descriptor_init(tds + IDLE_TASK_TID, IDLE_TASK_TID,
-                    28, tds, (void (*)(void))idle_main);
+                    28, 0, (void (*)(void))idle_main,
+                    stack_allocator_alloc(stacks, MEM_TASK_STACK_SIZE), MEM_TASK_STACK_SIZE);
+
+    // the rest of the descriptors start out free, generation 0
+    queue_init(&ctx->timer.sleepers);
+    queue_init(&ctx->free_tds);
+    for (size_t i = 2; i < TASK_DESCRIPTOR_MAX_TASKS; i++) {  // assumes IDLE_TASK_TID is 1
+        tds[i].tid = i;
+        tds[i].state = FREE;
+        tds[i].blocked_on = NULL;
+        queue_node_init(&tds[i].ready_node, tds + i);
+        queue_put(&ctx->free_tds, &tds[i].ready_node);
+    }
 
     // init priority queues
     scheduler_init(sch);
@@ -524,32 +1368,52 @@ void init(kernel_context_t *ctx, task_descriptor_t *tds, scheduler_t *sch, event
 
     ctx->tds = tds;
     ctx->sch = sch;
-    ctx->next_free_td = 2;  // assumes IDLE_TASK_TID is 1
+    ctx->stacks = stacks;
     ctx->eh = eh;
+    ctx->stats = stats;
     ctx->metrics.last_idle_time = 0;
 
-    *((volatile bool *)(MEM_TASK_STACK_START(IDLE_TASK_TID) - IDLE_TASK_EXIT_OFFSET)) = false;
-    *((volatile uint32_t *)(MEM_TASK_STACK_START(IDLE_TASK_TID) - IDLE_TASK_NON_IDLE_TIME_OFFSET)) = 0;
+    kernel_stats_init(stats);
+    trace_init();
+
+    idle_state.exit = false;
+    idle_state.non_idle_time = 0;
 
     setup_vectored_interrupts();
+
+    // vectors are in place, safe to switch on the caches
+    mmu_init();
 }
 
 void cleanup(void) {
+    kernel_fiq_disable();
+    mmu_cleanup();
     REG(0x38, 0) = 0x8348;
     REG(VIC2_BASE, VIC_VEC_ADDR_OFFSET) = 0;
     REG(VIC2_BASE, VIC_VEC_CTRL_N_OFFSET(0)) = 0;
     REG(VIC2_BASE, VIC_INT_EN_OFFSET) = 0;
+#ifndef UART1_FIQ_DISABLE
+    REG(VIC2_BASE, VIC_INT_SELECT_OFFSET) = 0;
+    REG(VIC2_BASE, VIC_SWI_CLEAR_OFFSET) = 1 << FIQ_SOFT_INT;
+    REG(0x3C, 0) = redboot_fiq_vector;
+#endif
     REG(TIMER3_BASE, CRTL_OFFSET) = 0;
+    REG(SYSCON_BASE, SYSCON_SWLOCK_OFFSET) = SWLOCK_UNLOCK;
+    REG(SYSCON_BASE, SYSCON_DEVICECFG_OFFSET) = redboot_devicecfg;
 }
 
 int main(void) {
     task_descriptor_t tds[TASK_DESCRIPTOR_MAX_TASKS];
     scheduler_t sch;
-    event_handler_t eh;
+    static event_handler_t eh;      // per-event queues, keep off the kernel stack
+    stack_allocator_t stacks;
     kernel_context_t ctx;
     kernel_request_t req;
+    static kernel_stats_t stats;    // too large for the kernel stack
+    uint32_t entry_type = KERNEL_STATS_ENTRY_TYPES;
+    uint32_t entry_time = 0;
 
-    init(&ctx, tds, &sch, &eh);
+    init(&ctx, tds, &sch, &eh, &stacks, &stats);
 
     while (true) {
         task_descriptor_t *active_td = scheduler_get(ctx.sch);
@@ -558,11 +1422,38 @@ int main(void) {
             break;
         }
 
+        active_td->state = ACTIVE;
+        kernel_cancel_timeout(&ctx, active_td);
+        trace_record(TRACE_SWITCH, active_td->tid, active_td->priority, 0, 0);
+
         if (active_td->tid == IDLE_TASK_TID) {
             update_idle_task(&ctx);
         }
 
-        activate(active_td, &req);
+        // cost of the previous kernel entry, from trap until now
+        clock_t now = clock();
+        uint32_t activate_time = (uint32_t)now;
+        kernel_arm_timer(&ctx, active_td, now);
+        kernel_stats_record(ctx.stats, entry_type, activate_time - entry_time);
+        task_descriptor_start_running(active_td, activate_time);
+        if (active_td->wake_event >= 0) {
+            kernel_stats_record_irq_latency(ctx.stats, active_td->wake_event,
+                                            activate_time - active_td->wake_time);
+            active_td->wake_event = -1;
+        }
+
+        req = task_switch(&active_td->sp);
+
+        entry_time = (uint32_t)clock();
+        entry_type = req == KERNEL_REQUEST_IRQ ? KERNEL_STATS_IRQ : req;
+        task_descriptor_stop_running(active_td, entry_time, entry_type == KERNEL_STATS_IRQ);
+        ctx.eh->irq_time = entry_time;
+        uint8_t active_tid = active_td->tid;    // Exit retires it in handle
+        if (entry_type != KERNEL_STATS_IRQ) {
+            trace_record(TRACE_SYSCALL_ENTRY, active_tid, req,
+                         ((uint32_t *)active_td->sp)[ARG0_OFFSET],
+                         ((uint32_t *)active_td->sp)[ARG1_OFFSET]);
+        }
 
         if (active_td->tid == IDLE_TASK_TID) {
             end_idle_task(&ctx);
@@ -571,10 +1462,19 @@ int main(void) {
         if (handle(&ctx, active_td, &req)) {
             break;
         }
+
+        if (entry_type != KERNEL_STATS_IRQ) {
+            // only a task put back on the ready queue has its return value set,
+            // one that blocked or exited gets none
+            bool returned = active_td->state == READY;
+            trace_record(TRACE_SYSCALL_EXIT, active_tid, req,
+                         returned ? ((uint32_t *)active_td->sp)[ARG0_OFFSET] : 0, !returned);
+        }
     }
 
-    volatile uint32_t *non_idle_time = (uint32_t *)(MEM_TASK_STACK_START(IDLE_TASK_TID) - IDLE_TASK_NON_IDLE_TIME_OFFSET);
-    bwprintf(COM2, "Non-idle time: %u/%u\n\r", *non_idle_time, clock());
+    bwprintf(COM2, "Non-idle time: %u/%u\n\r", idle_state.non_idle_time, clock());
+    kernel_stats_dump(ctx.stats);
+    trace_dump();
 
     cleanup();
 
@@ -0,0 +1,85 @@
+#include <internal/mmu.h>
+
+#ifndef MMU_DISABLE
+
+static uint32_t translation_table[MMU_SECTIONS] __attribute__ ((aligned (MMU_TABLE_ALIGN)));
+
+// RedBoot's MMU setup, restored on the way out
+static struct {
+    uint32_t control;
+    uint32_t ttb;
+} saved;
+
+void mmu_init(void) {
+    __asm__ volatile ("mrc p15, 0, %0, c1, c0, 0\n\t"
+                      "mrc p15, 0, %1, c2, c0, 0\n\t"
+                      : "=r" (saved.control), "=r" (saved.ttb));
+
+    // SDRAM is not physically contiguous, RedBoot's table is what maps its
+    // banks (and the stacks at the top of the range) into 0-32MB. Keep each
+    // entry and only change its cache bits. Devices live above RAM
+    // (UART1_BASE, TIMER3_BASE, VIC2_BASE are all in the 0x80000000 range)
+    // and must never be cached or buffered.
+    const uint32_t *redboot_table = (const uint32_t *)(saved.ttb & ~(MMU_TABLE_ALIGN - 1));
+    for (uint32_t i = 0; i < MMU_SECTIONS; i++) {
+        uint32_t entry = redboot_table[i];
+
+        if ((entry & MMU_DESCRIPTOR_TYPE) == MMU_SECTION_TYPE) {
+            entry &= ~(MMU_SECTION_CACHEABLE | MMU_SECTION_BUFFERABLE);
+            if (i >= (MMU_RAM_START >> MMU_SECTION_SHIFT) &&
+                i < ((MMU_RAM_START + MMU_RAM_SIZE) >> MMU_SECTION_SHIFT)) {
+                entry |= MMU_SECTION_CACHEABLE | MMU_SECTION_BUFFERABLE;
+            }
+        }
+        translation_table[i] = entry;
+    }
+
+    // domains are left as RedBoot set them, the entries still name them
+    __asm__ volatile ("mov r0, #0\n\t"
+                      "mcr p15, 0, r0, c7, c7, 0    @ Invalidate I and D caches\n\t"
+                      "mcr p15, 0, r0, c8, c7, 0    @ Invalidate TLBs\n\t"
+                      "mcr p15, 0, %0, c2, c0, 0    @ Set translation table base\n\t"
+                      "mrc p15, 0, r0, c1, c0, 0    @ Load control register\n\t"
+                      "orr r0, r0, %1               @ Enable MMU, D-cache and I-cache\n\t"
+                      "mcr p15, 0, r0, c1, c0, 0    @ Store control register\n\t"
+                      "nop\n\t"
+                      "nop\n\t"
+                      :                             // No output operands
+                      : "r" (translation_table),
+                        "r" (MMU_CTRL_MMU | MMU_CTRL_DCACHE | MMU_CTRL_ICACHE)
+                      : "r0", "memory");
+}
+
+void mmu_cleanup(void) {
+    // clean and invalidate every D-cache line by segment and index so
+    // RedBoot sees everything we wrote
+    for (uint32_t way = 0; way < MMU_DCACHE_WAYS; way++) {
+        for (uint32_t segment = 0; segment < MMU_DCACHE_SEGMENTS; segment++) {
+            uint32_t index = (way << 26) | (segment << 5);
+            __asm__ volatile ("mcr p15, 0, %0, c7, c14, 2" : : "r" (index) : "memory");
+        }
+    }
+
+    __asm__ volatile ("mov r0, #0\n\t"
+                      "mcr p15, 0, r0, c7, c10, 4   @ Drain write buffer\n\t"
+                      "mcr p15, 0, %0, c1, c0, 0    @ Restore control register, caches off\n\t"
+                      "nop\n\t"
+                      "nop\n\t"
+                      "mcr p15, 0, %1, c2, c0, 0    @ Restore translation table base\n\t"
+                      "mcr p15, 0, r0, c7, c7, 0    @ Invalidate I and D caches\n\t"
+                      "mcr p15, 0, r0, c8, c7, 0    @ Invalidate TLBs\n\t"
+                      :                             // No output operands
+                      : "r" (saved.control & ~(MMU_CTRL_DCACHE | MMU_CTRL_ICACHE)),
+                        "r" (saved.ttb)
+                      : "r0", "memory");
+}
+
+#else
+
+void mmu_init(void) {
+}
+
+void mmu_cleanup(void) {
+}
+
+#endif // MMU_DISABLE
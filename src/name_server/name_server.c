@@ -47,7 +47,7 @@ int RegisterAs(char *name) {
     // blocks here
     int rep;
     int res = Send(NAME_SERVER_TID, &msg, sizeof(msg), &rep, sizeof(rep));
-    if (res) {
+    if (res < 0) {
         bwprintf(COM2, "Unable to register with name_server\n\r");
         if (res == -1) {
             return NAME_SERVER_INVALID_TID;
@@ -67,7 +67,7 @@ int WhoIs(char *name) {
     int rep;
     do {
         int res = Send(NAME_SERVER_TID, &msg, sizeof(msg), &rep, sizeof(rep));
-        if (res) {
+        if (res < 0) {
             bwprintf(COM2, "Unable to register with name_server\n\r");
             if (res == -1) {
                 return NAME_SERVER_INVALID_TID;
@@ -135,13 +135,14 @@ void name_server_main() {
     name_server_msg_t msg;
     uint8_t sender_tid = 0;
 
+    int32_t ret = Receive(&sender_tid, &msg, sizeof(name_server_msg_t));
     do {
-        int32_t ret = Receive(&sender_tid, &msg, sizeof(name_server_msg_t));
         name_map_entry_t *entry = NULL;
         int rep = 0;
 
         if (ret <  0) {
             bwprintf(COM2, "Name server Receive failed: %d\n\r", ret);
+            ret = Receive(&sender_tid, &msg, sizeof(name_server_msg_t));
             continue;
         }
 
@@ -159,14 +160,19 @@ void name_server_main() {
                     rep = entry->tid;
                 }
                 break;
+            case NAME_SERVER_MSG_TYPE_EXIT:
+                continue;
             default:
+                ret = Receive(&sender_tid, &msg, sizeof(name_server_msg_t));
                 continue;
         }
 
-        // send reply back to blocked client
-        ret = Reply(sender_tid, &rep, sizeof(rep));
-        if (ret) {
+        // send reply back to blocked client and wait for the next request
+        ret = ReplyReceive(sender_tid, &rep, sizeof(rep),
+                           &sender_tid, &msg, sizeof(name_server_msg_t));
+        if (ret < 0) {
             bwprintf(COM2, "Name server reply error, tid:%d might be blocked\n\r", sender_tid);
+            ret = Receive(&sender_tid, &msg, sizeof(name_server_msg_t));
         }
     } while(msg.type != NAME_SERVER_MSG_TYPE_EXIT);
     msg.type = NAME_SERVER_MSG_TYPE_EXIT;
@@ -179,7 +185,7 @@ void name_server_exit() {
     name_server_msg_t msg, reply;
     msg.type = NAME_SERVER_MSG_TYPE_EXIT;
     int res = Send(NAME_SERVER_TID, &msg, sizeof(msg), &reply, sizeof(reply));
-    if (res) {
+    if (res < 0) {
         bwprintf(COM2, "Error shutting down name server\n\r");
     }
 }
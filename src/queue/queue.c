@@ -76,6 +76,46 @@ bool queue_empty(queue_t *ctx) {
     return (queue_size(ctx) == 0);
 }
 
+uint8_t queue_remove(queue_t *ctx, queue_node_t *node) {
+    queue_node_t *prev = NULL;
+    queue_node_t *curr = ctx->front;
+
+    while (curr != NULL && curr != node) {
+        prev = curr;
+        curr = curr->next;
+    }
+    if (curr == NULL) {
+        return 1;
+    }
+
+    if (prev == NULL) {
+        ctx->front = curr->next;
+    } else {
+        prev->next = curr->next;
+    }
+    if (ctx->back == curr) {
+        ctx->back = prev;
+    }
+    curr->next = NULL;
+    ctx->elements--;
+    return 0;
+}
+
+uint8_t queue_insert_after(queue_t *ctx, queue_node_t *parent, queue_node_t *node) {
+    if (node == NULL) {
+        return 1;
+    } else if (parent == NULL) {
+        return queue_put_front(ctx, node);
+    } else if (parent == ctx->back) {
+        return queue_put(ctx, node);
+    }
+
+    node->next = parent->next;
+    parent->next = node;
+    ctx->elements++;
+    return 0;
+}
+
 uint8_t queue_mtf(queue_t *ctx, queue_node_t *parent) {
     if (parent == NULL) {
         return 0;
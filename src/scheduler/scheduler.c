@@ -2,45 +2,50 @@
 
 #include <stddef.h>
 #include <bwio.h>
+#include <time.h>
 
-#define SCHEDULER_FULL_BITMAP   0xFFFFFFFFFFFFFFFFULL
-#define SCHEDULER_EMPTY_BITMAP  0ULL
-
-// find non-empty queue with highest priority from bitmap in O(lg(n))
-uint8_t bitmap_leadingzeroes(uint64_t bitmap) {
-    if (bitmap & 0x1ULL) {
-        return 0;
-    } else {
-        uint8_t count = 1;
-        if ((bitmap & 0xFFFFFFFFULL) == 0) {
-            bitmap >>= 32;
-            count += 32;
-        }
-        if ((bitmap & 0xFFFFULL) == 0) {
-            bitmap >>= 16;
-            count += 16;
-        }
-        if ((bitmap & 0xFFULL) == 0) {
-            bitmap >>= 8;
-            count += 8;
-        }
-        if ((bitmap & 0xFULL) == 0) {
-            bitmap >>= 4;
-            count += 4;
-        }
-        if ((bitmap & 0x3ULL) == 0) {
-            bitmap >>= 2;
-            count += 2;
-        }
-        count -= bitmap & 0x1ULL;
+#define GROUP(priority)     ((priority) / SCHEDULER_GROUP_SIZE)
+#define GROUP_BIT(priority) (1U << ((priority) % SCHEDULER_GROUP_SIZE))
+
+// index of the lowest set bit of a byte, ARMv4 has no clz
+static const uint8_t lowest_bit[256] = {
+    0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+};
 
-        return count;
+// find the lowest set bit of a non-zero word with at most 3 compares and a
+// table load
+static inline uint8_t lowest_bit_32(uint32_t word) {
+    if (word & 0xFF) {
+        return lowest_bit[word & 0xFF];
+    } else if (word & 0xFF00) {
+        return 8 + lowest_bit[(word >> 8) & 0xFF];
+    } else if (word & 0xFF0000) {
+        return 16 + lowest_bit[(word >> 16) & 0xFF];
     }
+    return 24 + lowest_bit[word >> 24];
 }
 
 void scheduler_init(scheduler_t *sch) {
-    sch->bitmap = SCHEDULER_EMPTY_BITMAP;
-    for (uint8_t i = 0; i < SCHEDULER_PRIORITY_COUNT; i++) {
+    sch->summary = 0;
+    for (uint8_t i = 0; i < SCHEDULER_GROUP_COUNT; i++) {
+        sch->groups[i] = 0;
+    }
+    for (uint16_t i = 0; i < SCHEDULER_PRIORITY_COUNT; i++) {
         queue_init(&(sch->priority_qs[i]));
     }
 }
@@ -51,29 +56,76 @@ task_descriptor_t *scheduler_get(scheduler_t *sch) {
         return NULL;
     }
 
-    uint8_t idx = bitmap_leadingzeroes(sch->bitmap);
+    uint8_t group = lowest_bit_32(sch->summary);
+    uint16_t idx = group * SCHEDULER_GROUP_SIZE + lowest_bit_32(sch->groups[group]);
     queue_t *max_queue = &(sch->priority_qs[idx]);
     task_descriptor_t *ret = queue_get(max_queue);
 
     if (queue_empty(max_queue)) {
-        sch->bitmap &= ~(1ULL << idx);
+        sch->groups[group] &= ~GROUP_BIT(idx);
+        if (!sch->groups[group]) {
+            sch->summary &= ~(1U << group);
+        }
     }
 
     return ret;
 }
 
+// mark a task that was just queued as ready
+static inline void scheduler_ready(scheduler_t *sch, task_descriptor_t *td) {
+    sch->groups[GROUP(td->priority)] |= GROUP_BIT(td->priority);
+    sch->summary |= 1U << GROUP(td->priority);
+    if (td->state != READY) {
+        task_descriptor_end_blocked(td, (uint32_t)clock());
+    }
+    td->state = READY;
+}
+
 uint8_t scheduler_put(scheduler_t *sch, task_descriptor_t *td) {
     uint8_t err = 0;
     err = queue_put(&(sch->priority_qs[td->priority]), &(td->ready_node));
 
     if (!err) {
-        sch->bitmap |= (1ULL << td->priority);
-        td->state = READY;
+        td->slice_left = td->quantum * TASK_DESCRIPTOR_TICK_CLOCKS;
+        scheduler_ready(sch, td);
+    }
+
+    return err;
+}
+
+uint8_t scheduler_put_front(scheduler_t *sch, task_descriptor_t *td) {
+    uint8_t err = 0;
+    err = queue_put_front(&(sch->priority_qs[td->priority]), &(td->ready_node));
+
+    if (!err) {
+        scheduler_ready(sch, td);
     }
 
     return err;
 }
 
+uint8_t scheduler_remove(scheduler_t *sch, task_descriptor_t *td) {
+    queue_t *queue = &(sch->priority_qs[td->priority]);
+    uint8_t err = queue_remove(queue, &(td->ready_node));
+
+    if (!err && queue_empty(queue)) {
+        sch->groups[GROUP(td->priority)] &= ~GROUP_BIT(td->priority);
+        if (!sch->groups[GROUP(td->priority)]) {
+            sch->summary &= ~(1U << GROUP(td->priority));
+        }
+    }
+
+    return err;
+}
+
+bool scheduler_has_ready(scheduler_t *sch, uint8_t priority) {
+    return !queue_empty(&(sch->priority_qs[priority]));
+}
+
+void scheduler_clear(scheduler_t *sch) {
+    scheduler_init(sch);
+}
+
 bool scheduler_empty(scheduler_t *sch) {
-    return (sch->bitmap == SCHEDULER_EMPTY_BITMAP);
+    return (sch->summary == 0);
 }
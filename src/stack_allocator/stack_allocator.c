@@ -0,0 +1,64 @@
+#include <internal/stack_allocator.h>
+
+#include <bool.h>
+#include <stddef.h>
+
+#define CHUNK_WORD(chunk)   ((chunk) / 32)
+#define CHUNK_BIT(chunk)    (1U << ((chunk) % 32))
+
+static void stack_allocator_mark(stack_allocator_t *ctx, size_t first, size_t count, bool used) {
+    for (size_t chunk = first; chunk < first + count; chunk++) {
+        if (used) {
+            ctx->bitmap[CHUNK_WORD(chunk)] |= CHUNK_BIT(chunk);
+        } else {
+            ctx->bitmap[CHUNK_WORD(chunk)] &= ~CHUNK_BIT(chunk);
+        }
+    }
+}
+
+void stack_allocator_init(stack_allocator_t *ctx, uintptr_t base) {
+    ctx->base = base;
+    for (size_t i = 0; i < STACK_ALLOCATOR_WORDS; i++) {
+        ctx->bitmap[i] = 0;
+    }
+}
+
+size_t stack_allocator_round(size_t size) {
+    return (size + STACK_ALLOCATOR_CHUNK_SIZE - 1) & ~(STACK_ALLOCATOR_CHUNK_SIZE - 1);
+}
+
+void *stack_allocator_alloc(stack_allocator_t *ctx, size_t size) {
+    size_t count = stack_allocator_round(size) / STACK_ALLOCATOR_CHUNK_SIZE;
+    if (count == 0 || count > STACK_ALLOCATOR_CHUNKS) {
+        return NULL;
+    }
+
+    size_t run = 0;
+    for (size_t chunk = 0; chunk < STACK_ALLOCATOR_CHUNKS; chunk++) {
+        // skip fully used words
+        if ((chunk % 32) == 0 && ctx->bitmap[CHUNK_WORD(chunk)] == 0xFFFFFFFF) {
+            run = 0;
+            chunk += 31;
+            continue;
+        }
+
+        if (ctx->bitmap[CHUNK_WORD(chunk)] & CHUNK_BIT(chunk)) {
+            run = 0;
+            continue;
+        }
+
+        run++;
+        if (run == count) {
+            size_t first = chunk + 1 - count;
+            stack_allocator_mark(ctx, first, count, true);
+            return (void *)(ctx->base + first * STACK_ALLOCATOR_CHUNK_SIZE);
+        }
+    }
+
+    return NULL;
+}
+
+void stack_allocator_free(stack_allocator_t *ctx, void *stack, size_t size) {
+    size_t first = ((uintptr_t)stack - ctx->base) / STACK_ALLOCATOR_CHUNK_SIZE;
+    stack_allocator_mark(ctx, first, stack_allocator_round(size) / STACK_ALLOCATOR_CHUNK_SIZE, false);
+}
@@ -1,6 +1,7 @@
 #include <bwio.h>
 #include <sys_call.h>
 #include <string.h>
+#include <stddef.h>
 
 #include <internal/sys_codes.h>
 
@@ -10,6 +11,12 @@ int Create(int priority, void (*code) ()) {
     return ret;
 }
 
+int CreateEx(int priority, void (*code) (), size_t stack_size) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_CREATEEX);
+    return ret;
+}
+
 int MyTid() {
     register int ret __asm__ ("r0");
     SWI(SYS_CODE_MYTID);
@@ -22,14 +29,44 @@ int MyParentTid() {
     return ret;
 }
 
+int SetQuantum(int ticks) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_SETQUANTUM);
+    return ret;
+}
+
+int SetTimer(int ticks) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_SETTIMER);
+    return ret;
+}
+
 void Pass() {
     SWI(SYS_CODE_PASS);
 }
 
+int Sleep(int ticks) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_SLEEP);
+    return ret;
+}
+
+int SleepUntil(int ticks) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_SLEEPUNTIL);
+    return ret;
+}
+
 void Exit() {
     SWI(SYS_CODE_EXIT);
 }
 
+int Destroy(uint8_t tid) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_DESTROY);
+    return ret;
+}
+
 int Send(uint8_t tid, void *msg, size_t msg_len, void *rep, size_t rep_len) {
     register int ret __asm__ ("r0");
     volatile send_params_t params = {tid, msg, msg_len, rep, rep_len};
@@ -41,23 +78,164 @@ int Send(uint8_t tid, void *msg, size_t msg_len, void *rep, size_t rep_len) {
     return ret;
 }
 
+int SendLoan(uint8_t tid, void *msg, size_t msg_len, void *rep, size_t rep_len) {
+    register int ret __asm__ ("r0");
+    volatile send_params_t params = {tid, msg, msg_len, rep, rep_len};
+    __asm__ volatile ("mov r0, %0\n\t"
+                      :
+                      : "r" (&params)
+                      : "r0");
+    SWI(SYS_CODE_SENDLOAN);
+    return ret;
+}
+
+int SendShort(uint8_t tid, void *msg, size_t msg_len, void *rep, size_t rep_len) {
+    const uint32_t *msg_words = (const uint32_t *)msg;
+    uint32_t *rep_words = (uint32_t *)rep;
+    if (msg_len > SYS_CALL_SHORT_MSG_MAX_LEN || rep_len > SYS_CALL_SHORT_MSG_MAX_LEN ||
+        (((uintptr_t)msg | (uintptr_t)rep) & 3)) {
+        return -2;
+    }
+
+    // words are loaded straight from msg, and the reply stored straight into rep
+    register uint32_t ctrl __asm__ ("r0") = SHORT_MSG_CTRL(tid, msg_len, rep_len);
+    register uint32_t word0 __asm__ ("r1") = msg_len > 0 ? msg_words[0] : 0;
+    register uint32_t word1 __asm__ ("r2") = msg_len > 4 ? msg_words[1] : 0;
+    register uint32_t word2 __asm__ ("r3") = msg_len > 8 ? msg_words[2] : 0;
+    __asm__ volatile ("mov ip, %4\n\t"
+                      "swi %4\n\t"
+                      : "+r" (ctrl), "+r" (word0), "+r" (word1), "+r" (word2)
+                      : "I" (SYS_CODE_SENDSHORT)
+                      : "ip", "memory");
+
+    if (rep_len > 0) {
+        rep_words[0] = word0;
+    }
+    if (rep_len > 4) {
+        rep_words[1] = word1;
+    }
+    if (rep_len > 8) {
+        rep_words[2] = word2;
+    }
+    return (int)ctrl;
+}
+
 int Receive(uint8_t *tid, void *msg, size_t msg_len) {
     register int ret __asm__ ("r0");
     SWI(SYS_CODE_RECEIVE);
     return ret;
 }
 
+int ReceiveShort(uint8_t *tid, void *msg, size_t msg_len) {
+    uint32_t *msg_words = (uint32_t *)msg;
+    if (msg_len > SYS_CALL_SHORT_MSG_MAX_LEN || ((uintptr_t)msg & 3)) {
+        return -2;
+    }
+
+    // the message comes back in r1-r3 and is stored straight into msg
+    register int ret __asm__ ("r0") = (int)tid;
+    register uint32_t word0 __asm__ ("r1") = msg_len;
+    register uint32_t word1 __asm__ ("r2");
+    register uint32_t word2 __asm__ ("r3");
+    __asm__ volatile ("mov ip, %4\n\t"
+                      "swi %4\n\t"
+                      : "+r" (ret), "+r" (word0), "=r" (word1), "=r" (word2)
+                      : "I" (SYS_CODE_RECEIVESHORT)
+                      : "ip", "memory");
+
+    if (ret < 0) {
+        return ret;
+    }
+    if (msg_len > 0) {
+        msg_words[0] = word0;
+    }
+    if (msg_len > 4) {
+        msg_words[1] = word1;
+    }
+    if (msg_len > 8) {
+        msg_words[2] = word2;
+    }
+    return ret;
+}
+
+int ReceiveTimeout(uint8_t *tid, void *msg, size_t msg_len, int ticks) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_RECEIVETIMEOUT);
+    return ret;
+}
+
+int ReceiveLoan(uint8_t *tid, void *msg, size_t msg_len, void **loan) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_RECEIVELOAN);
+    return ret;
+}
+
 int Reply(uint8_t tid, void *rep, size_t rep_len) {
     register int ret __asm__ ("r0");
     SWI(SYS_CODE_REPLY);
     return ret;
 }
+
+int ReplyReceive(uint8_t reply_tid, void *rep, size_t rep_len,
+                 uint8_t *tid, void *msg, size_t msg_len) {
+    register int ret __asm__ ("r0");
+    volatile reply_receive_params_t params = {reply_tid, rep, rep_len, tid, msg, msg_len, NULL};
+    __asm__ volatile ("mov r0, %0\n\t"
+                      :
+                      : "r" (&params)
+                      : "r0");
+    SWI(SYS_CODE_REPLYRECEIVE);
+    return ret;
+}
+
+int ReplyReceiveLoan(uint8_t reply_tid, void *rep, size_t rep_len,
+                     uint8_t *tid, void *msg, size_t msg_len, void **loan) {
+    register int ret __asm__ ("r0");
+    volatile reply_receive_params_t params = {reply_tid, rep, rep_len, tid, msg, msg_len, loan};
+    __asm__ volatile ("mov r0, %0\n\t"
+                      :
+                      : "r" (&params)
+                      : "r0");
+    SWI(SYS_CODE_REPLYRECEIVE);
+    return ret;
+}
+
 int AwaitEvent(int eventid) {
     register int ret __asm__ ("r0");
     SWI(SYS_CODE_AWAITEVENT);
     return ret;
 }
 
+int AwaitEventBuf(int eventid, void *buf, size_t len) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_AWAITEVENTBUF);
+    return ret;
+}
+
+int AwaitAny(uint32_t event_mask, int *which, int *data) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_AWAITANY);
+    return ret;
+}
+
+int BindEvent(int eventid) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_BINDEVENT);
+    return ret;
+}
+
+int AwaitEventTimeout(int eventid, int ticks) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_AWAITEVENTTIMEOUT);
+    return ret;
+}
+
+int TaskStats(uint8_t tid, task_stats_t *stats) {
+    register int ret __asm__ ("r0");
+    SWI(SYS_CODE_TASKSTATS);
+    return ret;
+}
+
 void panic(char *msg) {
     SWI(SYS_CODE_PANIC);
 }
@@ -2,26 +2,50 @@
 #include <internal/queue.h>
 #include <internal/mem.h>
 
+#include <stddef.h>
+#include <string.h>
+
 void task_descriptor_init(
         task_descriptor_t *ctx, uint8_t tid, uint8_t priority,
-        task_descriptor_t *parent, void (*code) (void))
+        int parent_tid, void (*code) (void), void *stack, size_t stack_size)
 {
+    uintptr_t stack_top = (uintptr_t)stack + stack_size;
+
     ctx->tid = tid;
     ctx->priority = priority;
-    ctx->parent = parent;
-    ctx->sp = (void *)(MEM_TASK_STACK_START(tid) - (14 * 4));
-    ctx->spsr = 0x50;
+    ctx->base_priority = priority;
+    ctx->quantum = TASK_DESCRIPTOR_DEFAULT_QUANTUM;
+    ctx->slice_left = TASK_DESCRIPTOR_DEFAULT_QUANTUM * TASK_DESCRIPTOR_TICK_CLOCKS;
+    ctx->parent_tid = parent_tid;
+    ctx->blocked_on = NULL;
+    ctx->stack = (uint8_t *)stack;
+    ctx->stack_size = stack_size;
+    memset(stack, TASK_DESCRIPTOR_STACK_PAINT, stack_size);
+
+    ctx->sp = (void *)(stack_top - (14 * 4));
+    ctx->spsr = 0x10;                   // user mode, irq and fiq enabled
     ctx->svc_lr = (void *)code;
     task_descriptor_set_return_value(ctx, 0);
 
     // Set stack variables properly
     // ((uint32_t *)ctx->sp)[0] = (uint32_t)code;
-    ((uint32_t *)ctx->sp)[13] = (MEM_TASK_STACK_START(tid));
+    ((uint32_t *)ctx->sp)[13] = stack_top;
 
     queue_node_init(&ctx->ready_node, (void *)ctx);
     queue_node_init(&ctx->send_node, (void *)ctx);
     queue_node_init(&ctx->await_node, (void *)ctx);
+    queue_node_init(&ctx->timer_node, (void *)ctx);
     queue_init(&ctx->send_q);
+    queue_init(&ctx->reply_q);
+
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    ctx->state_time = 0;
+    ctx->wake_event = -1;
+    ctx->wake_time = 0;
+    ctx->event_params.buf = NULL;
+    ctx->event_params.any_mask = 0;
+    ctx->bound_events = 0;
+    ctx->timeout_set = false;
 
     ctx->state = READY;
 }
@@ -29,3 +53,54 @@ void task_descriptor_init(
 void task_descriptor_set_return_value(task_descriptor_t *ctx, int ret) {
     *((int *)ctx->sp) = ret;
 }
+
+size_t task_descriptor_stack_used(task_descriptor_t *ctx) {
+    const uint32_t paint = TASK_DESCRIPTOR_STACK_PAINT * 0x01010101U;
+    const uint32_t *word = (const uint32_t *)ctx->stack;
+    const uint32_t *end = (const uint32_t *)(ctx->stack + ctx->stack_size);
+
+    while (word < end && *word == paint) {
+        word++;
+    }
+
+    return (uintptr_t)end - (uintptr_t)word;
+}
+
+void task_descriptor_start_running(task_descriptor_t *ctx, uint32_t now) {
+    ctx->stats.scheduled_count++;
+    ctx->state_time = now;
+}
+
+void task_descriptor_stop_running(task_descriptor_t *ctx, uint32_t now, bool preempted) {
+    uint32_t run_time = now - ctx->state_time;
+    ctx->stats.run_time += run_time;
+    ctx->slice_left = run_time < ctx->slice_left ? ctx->slice_left - run_time : 0;
+    ctx->state_time = now;
+    if (preempted) {
+        ctx->stats.preempted_count++;
+    }
+}
+
+void task_descriptor_end_blocked(task_descriptor_t *ctx, uint32_t now) {
+    uint32_t blocked_time = now - ctx->state_time;
+
+    switch (ctx->state) {
+        case SEND_BLOCKED:
+            ctx->stats.send_blocked_time += blocked_time;
+            break;
+        case RECEIVE_BLOCKED:
+            ctx->stats.receive_blocked_time += blocked_time;
+            break;
+        case REPLY_BLOCKED:
+            ctx->stats.reply_blocked_time += blocked_time;
+            break;
+        case EVENT_BLOCKED:
+            ctx->stats.event_blocked_time += blocked_time;
+            break;
+        case SLEEPING:
+            ctx->stats.sleep_time += blocked_time;
+            break;
+        default:
+            break;
+    }
+}
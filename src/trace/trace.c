@@ -0,0 +1,59 @@
+#include <internal/trace.h>
+
+#ifndef TRACE_DISABLE
+
+#include <bwio.h>
+#include <time.h>
+
+// Hooks are spread across the kernel so there is a single trace buffer
+static struct {
+    trace_event_t events[TRACE_BUFFER_EVENTS];
+    uint32_t next;
+    uint32_t count;
+} trace;
+
+void trace_init(void) {
+    trace.next = 0;
+    trace.count = 0;
+}
+
+void trace_record(trace_type_t type, uint8_t tid, uint8_t code, uint32_t arg0, uint32_t arg1) {
+    trace_event_t *event = &trace.events[trace.next];
+    clock_t now = clock();
+
+    event->time_low = (uint32_t)now;
+    event->time_high = (uint8_t)(now >> 32);
+    event->type = type;
+    event->tid = tid;
+    event->code = code;
+    event->arg0 = arg0;
+    event->arg1 = arg1;
+
+    trace.next = (trace.next + 1) % TRACE_BUFFER_EVENTS;
+    if (trace.count < TRACE_BUFFER_EVENTS) {
+        trace.count++;
+    }
+}
+
+static void trace_put_bytes(const void *data, size_t len) {
+    const char *bytes = (const char *)data;
+    for (size_t i = 0; i < len; i++) {
+        bwputc(COM2, bytes[i]);
+    }
+}
+
+void trace_dump(void) {
+    uint32_t clocks_per_sec = CLOCKS_PER_SEC;
+    uint32_t index = (trace.next + TRACE_BUFFER_EVENTS - trace.count) % TRACE_BUFFER_EVENTS;
+
+    trace_put_bytes(TRACE_DUMP_MAGIC, 4);
+    trace_put_bytes(&trace.count, sizeof(trace.count));
+    trace_put_bytes(&clocks_per_sec, sizeof(clocks_per_sec));
+
+    for (uint32_t i = 0; i < trace.count; i++) {
+        trace_put_bytes(&trace.events[index], sizeof(trace_event_t));
+        index = (index + 1) % TRACE_BUFFER_EVENTS;
+    }
+}
+
+#endif // TRACE_DISABLE
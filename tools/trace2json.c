@@ -0,0 +1,178 @@
+/*
+ * trace2json.c - convert a kernel trace dump to Chrome trace JSON
+ *
+ * Host program, build with `make tools`. Reads a capture of COM2 (which may
+ * contain other output around the dump) and writes JSON that can be loaded
+ * in chrome://tracing or Perfetto.
+ *
+ * usage: trace2json <capture> [out.json]
+ *
+ * The record layout and event types must match include/internal/trace.h.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_DUMP_MAGIC    "KTRC"
+#define TRACE_EVENT_SIZE    16
+#define KERNEL_PID          0
+#define TASK_PID            1
+
+enum {
+    TRACE_SYSCALL_ENTRY,
+    TRACE_SYSCALL_EXIT,
+    TRACE_IRQ,
+    TRACE_SWITCH,
+    TRACE_WAKEUP
+};
+
+typedef struct {
+    uint64_t time;
+    uint8_t type;
+    uint8_t tid;
+    uint8_t code;
+    uint32_t arg0;
+    uint32_t arg1;
+} event_t;
+
+static uint32_t read_u32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void parse_event(const unsigned char *p, event_t *event) {
+    event->time = read_u32(p) | ((uint64_t)p[4] << 32);
+    event->type = p[5];
+    event->tid = p[6];
+    event->code = p[7];
+    event->arg0 = read_u32(p + 8);
+    event->arg1 = read_u32(p + 12);
+}
+
+static double to_us(uint64_t time, uint64_t start, uint32_t clocks_per_sec) {
+    return (double)(time - start) * 1000000.0 / clocks_per_sec;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture> [out.json]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    // slurp the capture and find the last dump in it
+    size_t size = 0, cap = 1 << 16;
+    unsigned char *data = malloc(cap);
+    size_t n;
+    while (data && (n = fread(data + size, 1, cap - size, in)) > 0) {
+        size += n;
+        if (size == cap) {
+            cap *= 2;
+            data = realloc(data, cap);
+        }
+    }
+    fclose(in);
+    if (!data) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    const unsigned char *dump = NULL;
+    for (size_t i = 0; i + 12 <= size; i++) {
+        if (memcmp(data + i, TRACE_DUMP_MAGIC, 4) == 0) {
+            dump = data + i;
+        }
+    }
+    if (!dump) {
+        fprintf(stderr, "no trace dump found in %s\n", argv[1]);
+        return 1;
+    }
+
+    uint32_t count = read_u32(dump + 4);
+    uint32_t clocks_per_sec = read_u32(dump + 8);
+    const unsigned char *records = dump + 12;
+    size_t available = (size - (records - data)) / TRACE_EVENT_SIZE;
+    if (count > available) {
+        fprintf(stderr, "dump truncated, %u of %u events present\n", (unsigned)available, count);
+        count = available;
+    }
+    if (count == 0 || clocks_per_sec == 0) {
+        fprintf(stderr, "empty trace\n");
+        return 1;
+    }
+
+    event_t first, event, running;
+    int have_running = 0;
+    parse_event(records, &first);
+
+    fprintf(out, "{\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"kernel\"}},\n", KERNEL_PID);
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"tasks\"}}", TASK_PID);
+
+    for (uint32_t i = 0; i < count; i++) {
+        parse_event(records + i * TRACE_EVENT_SIZE, &event);
+        double ts = to_us(event.time, first.time, clocks_per_sec);
+
+        switch (event.type) {
+            case TRACE_SYSCALL_ENTRY:
+                fprintf(out, ",\n{\"name\":\"swi %u\",\"ph\":\"B\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+                        "\"args\":{\"arg0\":\"0x%x\",\"arg1\":\"0x%x\"}}",
+                        event.code, KERNEL_PID, event.tid, ts, event.arg0, event.arg1);
+                break;
+            case TRACE_SYSCALL_EXIT:
+                if (event.arg1) {
+                    // the task blocked or exited, there is no return value yet
+                    fprintf(out, ",\n{\"name\":\"swi %u\",\"ph\":\"E\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+                            "\"args\":{\"blocked\":true}}",
+                            event.code, KERNEL_PID, event.tid, ts);
+                } else {
+                    fprintf(out, ",\n{\"name\":\"swi %u\",\"ph\":\"E\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+                            "\"args\":{\"ret\":%d}}",
+                            event.code, KERNEL_PID, event.tid, ts, (int32_t)event.arg0);
+                }
+                break;
+            case TRACE_IRQ:
+                fprintf(out, ",\n{\"name\":\"irq %u\",\"ph\":\"i\",\"s\":\"p\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+                        "\"args\":{\"event\":%u}}",
+                        event.code, KERNEL_PID, event.tid, ts, event.arg0);
+                break;
+            case TRACE_SWITCH:
+                // a task runs from its switch until the next switch
+                if (have_running) {
+                    double start = to_us(running.time, first.time, clocks_per_sec);
+                    fprintf(out, ",\n{\"name\":\"task %u\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+                            "\"dur\":%.3f,\"args\":{\"priority\":%u}}",
+                            running.tid, TASK_PID, running.tid, start, ts - start, running.code);
+                }
+                running = event;
+                have_running = 1;
+                break;
+            case TRACE_WAKEUP:
+                fprintf(out, ",\n{\"name\":\"wakeup event %u\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+                        "\"args\":{\"data\":%d}}",
+                        event.code, TASK_PID, event.tid, ts, (int32_t)event.arg0);
+                break;
+            default:
+                fprintf(stderr, "unknown event type %u at record %u\n", event.type, i);
+                break;
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+    free(data);
+    return 0;
+}
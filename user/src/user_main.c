@@ -1,6 +1,13 @@
 #include <sys_call.h>
+#include <bench.h>
 
 void user_main(void) {
+#ifdef BENCH
+    // higher priority than us, each runs to completion before Create returns
+    Create(0, bench_string_main);
+    Create(0, bench_scheduler_main);
+    Create(0, bench_syscall_main);
+#endif
     while (1);
 
     Exit();